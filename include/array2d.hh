@@ -0,0 +1,91 @@
+#ifndef __INCLUDE_ARRAY2D_HH__
+#define __INCLUDE_ARRAY2D_HH__
+
+#include <concepts>
+#include <cstddef>
+#include <stdexcept>
+#include <vector>
+
+namespace lab {
+
+// Strided window into row-major storage: rows x cols elements, row i
+// starts at ptr + i * stride
+template <typename T> struct View2D {
+  T *ptr = nullptr;
+  std::size_t rows = 0, cols = 0, stride = 0;
+
+  T *operator[](std::size_t i) const { return ptr + i * stride; }
+};
+
+// Rectangle [i0, i0 + rows) x [j0, j0 + cols) of a 2D array
+struct Block {
+  std::size_t i0 = 0, j0 = 0, rows = 0, cols = 0;
+
+  bool empty() const { return rows == 0 || cols == 0; }
+};
+
+// Contiguous row-major 2D array. arr[i][j] addressing is kept, so it
+// replaces vector of vectors without touching the loops.
+template <typename T> class Array2D final {
+  std::vector<T> data_;
+  std::size_t rows_ = 0, cols_ = 0;
+
+public:
+  Array2D(std::size_t rows = 0, std::size_t cols = 0, T val = T{})
+      : data_(rows * cols, val), rows_(rows), cols_(cols) {}
+
+  template <std::invocable<std::size_t, std::size_t> Func>
+  Array2D(std::size_t rows, std::size_t cols, Func fill)
+      : Array2D(rows, cols) {
+    for (std::size_t i = 0; i < rows_; ++i)
+      for (std::size_t j = 0; j < cols_; ++j)
+        data_[i * cols_ + j] = fill(i, j);
+  }
+
+  T *operator[](std::size_t i) { return data_.data() + i * cols_; }
+  const T *operator[](std::size_t i) const { return data_.data() + i * cols_; }
+
+  T *data() { return data_.data(); }
+  const T *data() const { return data_.data(); }
+
+  std::size_t size() const { return data_.size(); }
+  std::size_t getRows() const { return rows_; }
+  std::size_t getCols() const { return cols_; }
+
+  View2D<T> block(std::size_t i0, std::size_t j0, std::size_t rows,
+                  std::size_t cols) {
+    checkBlock(i0, j0, rows, cols);
+    return {(*this)[i0] + j0, rows, cols, cols_};
+  }
+
+  View2D<const T> block(std::size_t i0, std::size_t j0, std::size_t rows,
+                        std::size_t cols) const {
+    checkBlock(i0, j0, rows, cols);
+    return {(*this)[i0] + j0, rows, cols, cols_};
+  }
+
+  View2D<T> block(const Block &blk) {
+    return block(blk.i0, blk.j0, blk.rows, blk.cols);
+  }
+
+  View2D<const T> block(const Block &blk) const {
+    return block(blk.i0, blk.j0, blk.rows, blk.cols);
+  }
+
+  View2D<T> row(std::size_t i) { return block(i, 0, 1, cols_); }
+  View2D<const T> row(std::size_t i) const { return block(i, 0, 1, cols_); }
+
+  View2D<T> col(std::size_t j) { return block(0, j, rows_, 1); }
+  View2D<const T> col(std::size_t j) const { return block(0, j, rows_, 1); }
+
+private:
+  void checkBlock(std::size_t i0, std::size_t j0, std::size_t rows,
+                  std::size_t cols) const {
+    if (i0 + rows > rows_ || j0 + cols > cols_)
+      throw std::out_of_range{"Block is out of array bounds"};
+  }
+};
+
+} // namespace lab
+
+#endif // __INCLUDE_ARRAY2D_HH__
@@ -0,0 +1,72 @@
+#ifndef __INCLUDE_ARRAY2D_MPI_HH__
+#define __INCLUDE_ARRAY2D_MPI_HH__
+
+#include <cstddef>
+#include <type_traits>
+
+#include <mpi/mpi.h>
+
+#include "array2d.hh"
+
+namespace lab {
+
+template <typename T> MPI::Datatype mpiType();
+template <> inline MPI::Datatype mpiType<char>() { return MPI::CHAR; }
+template <> inline MPI::Datatype mpiType<int>() { return MPI::INT; }
+template <> inline MPI::Datatype mpiType<float>() { return MPI::FLOAT; }
+template <> inline MPI::Datatype mpiType<double>() { return MPI::DOUBLE; }
+template <> inline MPI::Datatype mpiType<long double>() {
+  return MPI::LONG_DOUBLE;
+}
+
+// Committed derived datatype, freed when going out of scope. Freeing does
+// not affect operations that are already posted with it.
+class MpiType final {
+  MPI::Datatype type_;
+
+public:
+  explicit MpiType(MPI::Datatype type) : type_(type) { type_.Commit(); }
+  MpiType(const MpiType &) = delete;
+  MpiType &operator=(const MpiType &) = delete;
+  ~MpiType() { type_.Free(); }
+
+  operator const MPI::Datatype &() const { return type_; }
+};
+
+// Shape of the view as one element, to be used with view.ptr
+template <typename T> MpiType viewType(const View2D<T> &view) {
+  return MpiType{mpiType<std::remove_const_t<T>>().Create_vector(
+      view.rows, view.cols, view.stride)};
+}
+
+// Block of a rows x cols array, to be used with the array base pointer
+template <typename T>
+MpiType subarrayType(std::size_t rows, std::size_t cols, const Block &blk) {
+  const int sizes[] = {static_cast<int>(rows), static_cast<int>(cols)};
+  const int subsizes[] = {static_cast<int>(blk.rows),
+                          static_cast<int>(blk.cols)};
+  const int starts[] = {static_cast<int>(blk.i0), static_cast<int>(blk.j0)};
+
+  return MpiType{mpiType<T>().Create_subarray(2, sizes, subsizes, starts,
+                                              MPI::ORDER_C)};
+}
+
+// Tile [i0, i0 + rows) x [j0, j0 + cols) of arr, to be used with arr.data()
+template <typename T>
+MpiType subarrayType(const Array2D<T> &arr, std::size_t i0, std::size_t j0,
+                     std::size_t rows, std::size_t cols) {
+  return subarrayType<T>(arr.getRows(), arr.getCols(), {i0, j0, rows, cols});
+}
+
+// Column of rows elements stride apart with the extent of one element, so
+// count n covers n adjacent columns (e.g. column blocks in Gatherv)
+template <typename T> MpiType columnsType(std::size_t rows, std::size_t stride) {
+  auto col = mpiType<T>().Create_vector(rows, 1, stride);
+  auto res = col.Create_resized(0, sizeof(T));
+  col.Free();
+  return MpiType{res};
+}
+
+} // namespace lab
+
+#endif // __INCLUDE_ARRAY2D_MPI_HH__
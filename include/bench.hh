@@ -0,0 +1,245 @@
+#ifndef __INCLUDE_BENCH_HH__
+#define __INCLUDE_BENCH_HH__
+
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <chrono>
+#include <cstddef>
+#include <functional>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace lab {
+
+enum class Phase { Init, Compute, Comm, Output };
+constexpr std::size_t NPHASES = 4;
+
+inline std::string_view phaseName(Phase phase) {
+  constexpr std::array<std::string_view, NPHASES> names{"init", "compute",
+                                                        "comm", "output"};
+  return names[static_cast<std::size_t>(phase)];
+}
+
+// Times of one run by phases, in seconds
+class PhaseTimer final {
+  std::array<double, NPHASES> sec_{};
+
+public:
+  // Runs f and adds its wall time to phase
+  template <typename F> decltype(auto) time(Phase phase, F &&f) {
+    struct Guard {
+      double &acc;
+      std::chrono::steady_clock::time_point tic =
+          std::chrono::steady_clock::now();
+      ~Guard() {
+        acc += std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                             tic)
+                   .count();
+      }
+    } guard{sec_[static_cast<std::size_t>(phase)]};
+    return std::forward<F>(f)();
+  }
+
+  double operator[](Phase phase) const {
+    return sec_[static_cast<std::size_t>(phase)];
+  }
+  double &operator[](Phase phase) {
+    return sec_[static_cast<std::size_t>(phase)];
+  }
+};
+
+// One benchmarked kernel. init prepares fresh input before every run,
+// compute may mark its communication with timer.time(Phase::Comm, ...)
+// and output it streams with timer.time(Phase::Output, ...), output is
+// optional.
+struct BenchCase {
+  std::function<void()> init;
+  std::function<void(PhaseTimer &)> compute;
+  std::function<void()> output{};
+};
+
+struct BenchConfig {
+  // untimed runs of init + compute before the measured ones
+  std::size_t warmup = 1;
+  std::size_t repeats = 5;
+  // called before every phase, e.g. a barrier for MPI programs
+  std::function<void()> sync{};
+};
+
+struct Stats {
+  double min = 0, median = 0, max = 0;
+};
+
+using PhaseStats = std::array<Stats, NPHASES>;
+
+inline Stats makeStats(std::vector<double> samples) {
+  if (samples.empty())
+    return {};
+
+  std::sort(samples.begin(), samples.end());
+  auto mid = samples.size() / 2;
+  auto median = samples.size() % 2 != 0
+                    ? samples[mid]
+                    : (samples[mid - 1] + samples[mid]) / 2;
+  return {samples.front(), median, samples.back()};
+}
+
+// Runs bc cfg.warmup + cfg.repeats times in process. Compute time does not
+// include the communication and output marked inside it.
+inline PhaseStats runBench(const BenchCase &bc, const BenchConfig &cfg) {
+  auto sync = [&cfg] {
+    if (cfg.sync)
+      cfg.sync();
+  };
+
+  for (std::size_t rep = 0; rep < cfg.warmup; ++rep) {
+    PhaseTimer timer{};
+    sync(), bc.init();
+    sync(), bc.compute(timer);
+  }
+
+  std::array<std::vector<double>, NPHASES> samples{};
+  for (std::size_t rep = 0; rep < cfg.repeats; ++rep) {
+    PhaseTimer timer{};
+    sync();
+    timer.time(Phase::Init, bc.init);
+    sync();
+    // output streamed by compute is counted as output only
+    auto streamed = timer[Phase::Output];
+    timer.time(Phase::Compute, [&] { bc.compute(timer); });
+    streamed = timer[Phase::Output] - streamed;
+    if (bc.output) {
+      sync();
+      timer.time(Phase::Output, bc.output);
+    }
+    sync();
+
+    timer[Phase::Compute] -= timer[Phase::Comm] + streamed;
+    for (std::size_t ph = 0; ph < NPHASES; ++ph)
+      samples[ph].push_back(timer[static_cast<Phase>(ph)]);
+  }
+
+  PhaseStats res{};
+  for (std::size_t ph = 0; ph < NPHASES; ++ph)
+    res[ph] = makeStats(std::move(samples[ph]));
+  return res;
+}
+
+// Result of one kernel on one rank with the run parameters needed for
+// strong and weak scaling plots
+struct BenchRecord {
+  std::string name;
+  int rank = 0, ranks = 1, threads = 1;
+  std::size_t rows = 0, cols = 0, repeats = 0;
+  PhaseStats stats{};
+};
+
+enum class ReportFormat { Csv, Json };
+
+// One line per record and phase, times in ms
+inline void writeReport(std::ostream &ost,
+                        const std::vector<BenchRecord> &records,
+                        ReportFormat fmt) {
+  if (fmt == ReportFormat::Csv) {
+    ost << "name,rank,ranks,threads,rows,cols,repeats,phase,min_ms,"
+           "median_ms,max_ms\n";
+    for (auto &&rec : records)
+      for (std::size_t ph = 0; ph < NPHASES; ++ph) {
+        auto &&st = rec.stats[ph];
+        ost << rec.name << ',' << rec.rank << ',' << rec.ranks << ','
+            << rec.threads << ',' << rec.rows << ',' << rec.cols << ','
+            << rec.repeats << ',' << phaseName(static_cast<Phase>(ph)) << ','
+            << st.min * 1e3 << ',' << st.median * 1e3 << ',' << st.max * 1e3
+            << '\n';
+      }
+    ost.flush();
+    return;
+  }
+
+  ost << "[\n";
+  for (std::size_t r = 0; r < records.size(); ++r) {
+    auto &&rec = records[r];
+    ost << "  {\"name\": \"" << rec.name << "\", \"rank\": " << rec.rank
+        << ", \"ranks\": " << rec.ranks << ", \"threads\": " << rec.threads
+        << ", \"rows\": " << rec.rows << ", \"cols\": " << rec.cols
+        << ", \"repeats\": " << rec.repeats << ", \"phases\": {";
+    for (std::size_t ph = 0; ph < NPHASES; ++ph) {
+      auto &&st = rec.stats[ph];
+      ost << (ph != 0 ? ", " : "") << '"'
+          << phaseName(static_cast<Phase>(ph)) << "\": {\"min_ms\": "
+          << st.min * 1e3 << ", \"median_ms\": " << st.median * 1e3
+          << ", \"max_ms\": " << st.max * 1e3 << '}';
+    }
+    ost << "}}" << (r + 1 < records.size() ? "," : "") << '\n';
+  }
+  ost << "]" << std::endl;
+}
+
+// Options shared by the lab programs:
+//   "bench[=N]": N measured runs (cfg.repeats by default) and a report
+//                instead of the plain timings
+//   "warmup=N": untimed runs before the measured ones
+//   "report=csv|json": report format
+//   "size=RxC": problem size, rows x cols
+struct BenchArgs {
+  bool bench = false;
+  BenchConfig cfg{};
+  ReportFormat fmt = ReportFormat::Csv;
+  std::size_t rows = 0, cols = 0;
+};
+
+// Whole of str as a number, throws std::invalid_argument otherwise
+inline std::size_t parseCount(std::string_view str) {
+  std::size_t res = 0;
+  auto [ptr, ec] = std::from_chars(str.data(), str.data() + str.size(), res);
+  if (ec != std::errc{} || ptr != str.data() + str.size())
+    throw std::invalid_argument{"Bad number: " + std::string{str}};
+  return res;
+}
+
+// Same for a real number
+inline long double parseReal(std::string_view str) {
+  long double res = 0;
+  auto [ptr, ec] = std::from_chars(str.data(), str.data() + str.size(), res);
+  if (ec != std::errc{} || ptr != str.data() + str.size())
+    throw std::invalid_argument{"Bad number: " + std::string{str}};
+  return res;
+}
+
+// Returns false if arg is none of the options above
+inline bool parseBenchArg(std::string_view arg, BenchArgs &args) {
+  auto value = [arg](std::string_view key) {
+    return arg.substr(key.size());
+  };
+
+  if (arg == "bench")
+    args.bench = true;
+  else if (arg.starts_with("bench="))
+    args.bench = true, args.cfg.repeats = parseCount(value("bench="));
+  else if (arg.starts_with("warmup="))
+    args.cfg.warmup = parseCount(value("warmup="));
+  else if (arg == "report=csv")
+    args.fmt = ReportFormat::Csv;
+  else if (arg == "report=json")
+    args.fmt = ReportFormat::Json;
+  else if (arg.starts_with("size=")) {
+    auto size = value("size=");
+    auto pos = size.find('x');
+    if (pos == std::string_view::npos)
+      throw std::invalid_argument{"Size must be RxC"};
+    args.rows = parseCount(size.substr(0, pos));
+    args.cols = parseCount(size.substr(pos + 1));
+  } else
+    return false;
+
+  return true;
+}
+
+} // namespace lab
+
+#endif // __INCLUDE_BENCH_HH__
@@ -0,0 +1,45 @@
+#ifndef __INCLUDE_BENCH_MPI_HH__
+#define __INCLUDE_BENCH_MPI_HH__
+
+#include <cstddef>
+#include <vector>
+
+#include <mpi/mpi.h>
+
+#include "bench.hh"
+
+namespace lab {
+
+// Records of all ranks of comm on rank 0, in rank order; other ranks get
+// an empty vector. Everything but the timings is taken from rank 0.
+inline std::vector<BenchRecord> gatherRecords(const MPI::Intracomm &comm,
+                                              const BenchRecord &rec) {
+  constexpr std::size_t NVALS = 3 * NPHASES;
+  std::vector<double> vals{};
+  for (auto &&st : rec.stats)
+    vals.insert(vals.end(), {st.min, st.median, st.max});
+
+  auto rank = comm.Get_rank();
+  auto commsize = comm.Get_size();
+  std::vector<double> all(rank == 0 ? NVALS * commsize : 0);
+  comm.Gather(vals.data(), NVALS, MPI::DOUBLE, all.data(), NVALS, MPI::DOUBLE,
+              0);
+
+  std::vector<BenchRecord> res{};
+  if (rank != 0)
+    return res;
+
+  for (int r = 0; r < commsize; ++r) {
+    auto &&cur = res.emplace_back(rec);
+    cur.rank = r;
+    for (std::size_t ph = 0; ph < NPHASES; ++ph) {
+      auto base = all.data() + NVALS * r + 3 * ph;
+      cur.stats[ph] = {base[0], base[1], base[2]};
+    }
+  }
+  return res;
+}
+
+} // namespace lab
+
+#endif // __INCLUDE_BENCH_MPI_HH__
@@ -0,0 +1,95 @@
+#ifndef __INCLUDE_DUMP_HH__
+#define __INCLUDE_DUMP_HH__
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+
+#include "array2d.hh"
+
+namespace lab {
+
+// Binary dump: DumpHeader followed by `count` arrays of rows x cols
+// elements of type dtype, each stored in the given layout, native endian.
+enum class DType : std::uint32_t { F32 = 0, F64 = 1, F80 = 2 };
+enum class Layout : std::uint32_t { RowMajor = 0, ColMajor = 1 };
+
+template <typename T> constexpr DType dtypeOf();
+template <> constexpr DType dtypeOf<float>() { return DType::F32; }
+template <> constexpr DType dtypeOf<double>() { return DType::F64; }
+template <> constexpr DType dtypeOf<long double>() { return DType::F80; }
+
+inline std::size_t dtypeSize(DType dtype) {
+  switch (dtype) {
+  case DType::F32:
+    return sizeof(float);
+  case DType::F64:
+    return sizeof(double);
+  case DType::F80:
+    return sizeof(long double);
+  }
+  throw std::invalid_argument{"Unknown dump element type"};
+}
+
+struct DumpHeader {
+  static constexpr char MAGIC[8] = "LABDUMP";
+  static constexpr std::uint32_t VERSION = 1;
+
+  char magic[8]{};
+  std::uint32_t version = VERSION;
+  DType dtype = DType::F64;
+  Layout layout = Layout::RowMajor;
+  std::uint32_t count = 0;
+  std::uint64_t rows = 0, cols = 0;
+
+  DumpHeader() { std::memcpy(magic, MAGIC, sizeof(magic)); }
+
+  bool valid() const {
+    return std::memcmp(magic, MAGIC, sizeof(magic)) == 0 &&
+           version == VERSION;
+  }
+
+  std::size_t arrayBytes() const { return rows * cols * dtypeSize(dtype); }
+};
+
+// Whole arrays in one write each, for single-process programs
+template <typename T> class DumpFile final {
+  std::ofstream of_;
+  DumpHeader hdr_{};
+
+public:
+  explicit DumpFile(const std::string &name)
+      : of_(name, std::ios::binary | std::ios::trunc) {
+    if (!of_)
+      throw std::runtime_error{"Cannot open file for results: " + name};
+
+    hdr_.dtype = dtypeOf<T>();
+    of_.write(reinterpret_cast<const char *>(&hdr_), sizeof(hdr_));
+  }
+
+  DumpFile(const DumpFile &) = delete;
+  DumpFile &operator=(const DumpFile &) = delete;
+
+  ~DumpFile() {
+    of_.seekp(0);
+    of_.write(reinterpret_cast<const char *>(&hdr_), sizeof(hdr_));
+  }
+
+  void write(const Array2D<T> &arr) {
+    if (hdr_.count != 0 && (hdr_.rows != arr.getRows() ||
+                            hdr_.cols != arr.getCols()))
+      throw std::invalid_argument{"Arrays of one dump must be of one shape"};
+
+    hdr_.rows = arr.getRows(), hdr_.cols = arr.getCols();
+    ++hdr_.count;
+    of_.write(reinterpret_cast<const char *>(arr.data()),
+              arr.size() * sizeof(T));
+  }
+};
+
+} // namespace lab
+
+#endif // __INCLUDE_DUMP_HH__
@@ -0,0 +1,172 @@
+#ifndef __INCLUDE_DUMP_MPI_HH__
+#define __INCLUDE_DUMP_MPI_HH__
+
+#include <algorithm>
+#include <charconv>
+#include <cstddef>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <vector>
+
+#include <mpi/mpi.h>
+
+#include "array2d.hh"
+#include "array2d_mpi.hh"
+#include "dump.hh"
+
+namespace lab {
+
+// Array dump written by all ranks of a communicator at once with MPI-IO,
+// every rank's block goes through a subarray file view in one Write_all.
+//   Binary: DumpHeader + raw elements, blocks are written without a copy;
+//   Text: every element takes exactly TEXT_WIDTH chars (value right-aligned
+//         plus a space, or a newline after the last column), so the file
+//         is a char matrix.
+class DumpWriter final {
+public:
+  enum class Format { Binary, Text };
+
+  static constexpr std::size_t TEXT_WIDTH = 15;
+  static constexpr int PRECISION = 6;
+
+private:
+  MPI::File fh_;
+  Format fmt_;
+  bool root_;
+  DumpHeader hdr_{};
+  MPI::Offset disp_ = 0;
+
+public:
+  DumpWriter(const MPI::Intracomm &comm, const std::string &name,
+             Format fmt = Format::Binary)
+      : fh_(MPI::File::Open(comm, name.c_str(),
+                            MPI::MODE_CREATE | MPI::MODE_WRONLY,
+                            MPI::INFO_NULL)),
+        fmt_(fmt), root_(comm.Get_rank() == 0) {
+    fh_.Set_size(0);
+    if (fmt_ == Format::Binary)
+      disp_ = sizeof(DumpHeader);
+  }
+
+  DumpWriter(const DumpWriter &) = delete;
+  DumpWriter &operator=(const DumpWriter &) = delete;
+
+  ~DumpWriter() {
+    if (fmt_ == Format::Binary) {
+      fh_.Set_view(0, MPI::BYTE, MPI::BYTE, "native", MPI::INFO_NULL);
+      if (root_)
+        fh_.Write_at(0, &hdr_, sizeof(hdr_), MPI::BYTE);
+    }
+    fh_.Close();
+  }
+
+  // Appends a rows x cols array. Collective: every rank passes the block
+  // it owns (possibly empty) together with its data.
+  void write(std::size_t rows, std::size_t cols, const Block &blk,
+             View2D<const double> data) {
+    if (hdr_.count != 0 && (hdr_.rows != rows || hdr_.cols != cols))
+      throw std::invalid_argument{"Arrays of one dump must be of one shape"};
+    hdr_.rows = rows, hdr_.cols = cols;
+    ++hdr_.count;
+
+    if (fmt_ == Format::Binary)
+      writeBinary(rows, cols, blk, data);
+    else
+      writeText(rows, cols, blk, data);
+  }
+
+private:
+  void writeBinary(std::size_t rows, std::size_t cols, const Block &blk,
+                   View2D<const double> data) {
+    if (blk.empty()) {
+      fh_.Set_view(disp_, MPI::DOUBLE, MPI::DOUBLE, "native", MPI::INFO_NULL);
+      fh_.Write_all(nullptr, 0, MPI::DOUBLE);
+    } else {
+      auto ftype = subarrayType<double>(rows, cols, blk);
+      fh_.Set_view(disp_, MPI::DOUBLE, ftype, "native", MPI::INFO_NULL);
+      fh_.Write_all(data.ptr, 1, viewType(data));
+    }
+
+    disp_ += rows * cols * sizeof(double);
+  }
+
+  void writeText(std::size_t rows, std::size_t cols, const Block &blk,
+                 View2D<const double> data) {
+    auto buf = format(cols, blk, data);
+
+    if (blk.empty())
+      fh_.Set_view(disp_, MPI::CHAR, MPI::CHAR, "native", MPI::INFO_NULL);
+    else {
+      auto ftype = subarrayType<char>(rows, cols * TEXT_WIDTH,
+                                      {blk.i0, blk.j0 * TEXT_WIDTH, blk.rows,
+                                       blk.cols * TEXT_WIDTH});
+      fh_.Set_view(disp_, MPI::CHAR, ftype, "native", MPI::INFO_NULL);
+    }
+
+    fh_.Write_all(buf.data(), buf.size(), MPI::CHAR);
+    disp_ += rows * cols * TEXT_WIDTH;
+  }
+
+  static std::vector<char> format(std::size_t cols, const Block &blk,
+                                  View2D<const double> data) {
+    std::vector<char> buf(blk.rows * blk.cols * TEXT_WIDTH, ' ');
+
+    for (std::size_t i = 0; i < blk.rows; ++i)
+      for (std::size_t j = 0; j < blk.cols; ++j) {
+        auto rec = &buf[(i * blk.cols + j) * TEXT_WIDTH];
+        char tmp[TEXT_WIDTH];
+        auto [end, ec] = std::to_chars(tmp, tmp + TEXT_WIDTH - 1, data[i][j],
+                                       std::chars_format::scientific,
+                                       PRECISION);
+        auto len = ec == std::errc{} ? end - tmp : 0;
+
+        std::copy(tmp, tmp + len, rec + TEXT_WIDTH - 1 - len);
+        rec[TEXT_WIDTH - 1] = blk.j0 + j + 1 == cols ? '\n' : ' ';
+      }
+
+    return buf;
+  }
+};
+
+// Binary dump of one rows x cols array whose rows are written one by one,
+// by any rank, as soon as they are ready. The shape is known in advance,
+// so the header goes first and rows need no collective calls.
+template <typename T> class RowStream final {
+  MPI::File fh_;
+  std::size_t rows_, cols_;
+
+public:
+  RowStream(const MPI::Intracomm &comm, const std::string &name,
+            std::size_t rows, std::size_t cols)
+      : fh_(MPI::File::Open(comm, name.c_str(),
+                            MPI::MODE_CREATE | MPI::MODE_WRONLY,
+                            MPI::INFO_NULL)),
+        rows_(rows), cols_(cols) {
+    fh_.Set_size(0);
+    if (comm.Get_rank() != 0)
+      return;
+
+    DumpHeader hdr{};
+    hdr.dtype = dtypeOf<T>();
+    hdr.count = 1, hdr.rows = rows, hdr.cols = cols;
+    fh_.Write_at(0, &hdr, sizeof(hdr), MPI::BYTE);
+  }
+
+  RowStream(const RowStream &) = delete;
+  RowStream &operator=(const RowStream &) = delete;
+
+  // Collective
+  ~RowStream() { fh_.Close(); }
+
+  void write(std::size_t i, const T *row) {
+    if (i >= rows_)
+      throw std::out_of_range{"Row is out of the dump"};
+    fh_.Write_at(sizeof(DumpHeader) + i * cols_ * sizeof(T), row, cols_,
+                 mpiType<T>());
+  }
+};
+
+} // namespace lab
+
+#endif // __INCLUDE_DUMP_MPI_HH__
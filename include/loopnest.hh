@@ -0,0 +1,182 @@
+#ifndef __INCLUDE_LOOPNEST_HH__
+#define __INCLUDE_LOOPNEST_HH__
+
+#include <algorithm>
+#include <cstddef>
+#include <string_view>
+#include <vector>
+
+#include <omp.h>
+
+namespace lab {
+
+// Distance vector of a 2D loop nest as derived from the Bernstein
+// condition: D = l - k, where iteration k writes a cell and iteration l
+// reads it. Lexicographically negative D is an anti-dependence.
+struct Dep {
+  long di = 0, dj = 0;
+
+  bool anti() const { return di < 0 || (di == 0 && dj < 0); }
+  // Distance from the iteration that must go first to the one after it
+  Dep normalized() const { return anti() ? Dep{-di, -dj} : *this; }
+};
+
+// Iterations [ibeg, iend) x [jbeg, jend) with uniform dependences
+struct LoopNest2D {
+  std::size_t ibeg = 0, iend = 0, jbeg = 0, jend = 0;
+  std::vector<Dep> deps{};
+  // Body reads anti-dependent data from its own copy, so anti-dependences
+  // do not constrain the order
+  bool privatized_anti = false;
+  // Minimal tile sizes, enlarged up to the dependence distances if needed
+  std::size_t tile_i = 64, tile_j = 512;
+};
+
+enum class Schedule {
+  // no dependences: tiles in any order
+  Parallel,
+  // dependences inside rows only: rows in parallel
+  Rows,
+  // dependences along columns only: column strips in parallel
+  Columns,
+  // j is skewed by skew * i so that all distances become nonnegative,
+  // tiles of one anti-diagonal run in parallel; with i being the time step
+  // this is time-skewed tiling
+  Wavefront
+};
+
+inline std::string_view scheduleName(Schedule sched) {
+  switch (sched) {
+  case Schedule::Parallel:
+    return "parallel";
+  case Schedule::Rows:
+    return "rows";
+  case Schedule::Columns:
+    return "columns";
+  case Schedule::Wavefront:
+    return "wavefront";
+  }
+  return "unknown";
+}
+
+struct Plan {
+  Schedule sched = Schedule::Parallel;
+  std::size_t skew = 0, tile_i = 0, tile_j = 0;
+};
+
+inline Plan plan(const LoopNest2D &nest) {
+  std::vector<Dep> deps{};
+  for (auto &&dep : nest.deps)
+    if ((dep.di != 0 || dep.dj != 0) && !(dep.anti() && nest.privatized_anti))
+      deps.push_back(dep.normalized());
+
+  Plan res{Schedule::Parallel, 0, nest.tile_i, nest.tile_j};
+  if (deps.empty())
+    return res;
+
+  auto in_rows = std::all_of(deps.begin(), deps.end(),
+                             [](auto &&dep) { return dep.di == 0; });
+  auto in_cols = std::all_of(deps.begin(), deps.end(),
+                             [](auto &&dep) { return dep.dj == 0; });
+  if (in_rows) {
+    res.sched = Schedule::Rows;
+    return res;
+  }
+  if (in_cols) {
+    res.sched = Schedule::Columns;
+    return res;
+  }
+
+  // Smallest skew making dj + skew * di >= 0 for every distance (di > 0
+  // here unless dj > 0 already)
+  long skew = 0;
+  for (auto &&dep : deps)
+    if (dep.dj < 0)
+      skew = std::max(skew, (-dep.dj + dep.di - 1) / dep.di);
+
+  // Tiles at least as large as the distances depend only on the tiles
+  // above, to the left and above-left
+  res.sched = Schedule::Wavefront;
+  res.skew = skew;
+  for (auto &&dep : deps) {
+    res.tile_i = std::max<std::size_t>(res.tile_i, dep.di);
+    res.tile_j = std::max<std::size_t>(res.tile_j, dep.dj + skew * dep.di);
+  }
+  return res;
+}
+
+// Runs body(i, jb, je) over row pieces of the nest so that every
+// dependence is respected; body must go through its piece in increasing j.
+template <typename Body> void run(const LoopNest2D &nest, Body body) {
+  if (nest.ibeg >= nest.iend || nest.jbeg >= nest.jend)
+    return;
+
+  auto pln = plan(nest);
+  std::size_t rows = nest.iend - nest.ibeg, cols = nest.jend - nest.jbeg;
+  std::size_t ntiles_i = (rows + pln.tile_i - 1) / pln.tile_i,
+              ntiles_j = (cols + pln.tile_j - 1) / pln.tile_j;
+
+  switch (pln.sched) {
+  case Schedule::Parallel:
+#pragma omp parallel for collapse(2) schedule(static)
+    for (std::size_t ti = 0; ti < ntiles_i; ++ti)
+      for (std::size_t tj = 0; tj < ntiles_j; ++tj) {
+        auto ib = nest.ibeg + ti * pln.tile_i,
+             ie = std::min(ib + pln.tile_i, nest.iend);
+        auto jb = nest.jbeg + tj * pln.tile_j,
+             je = std::min(jb + pln.tile_j, nest.jend);
+        for (auto i = ib; i < ie; ++i)
+          body(i, jb, je);
+      }
+    return;
+
+  case Schedule::Rows:
+#pragma omp parallel for schedule(static)
+    for (auto i = nest.ibeg; i < nest.iend; ++i)
+      body(i, nest.jbeg, nest.jend);
+    return;
+
+  case Schedule::Columns:
+#pragma omp parallel for schedule(static)
+    for (std::size_t tj = 0; tj < ntiles_j; ++tj) {
+      auto jb = nest.jbeg + tj * pln.tile_j,
+           je = std::min(jb + pln.tile_j, nest.jend);
+      for (auto i = nest.ibeg; i < nest.iend; ++i)
+        body(i, jb, je);
+    }
+    return;
+
+  case Schedule::Wavefront:
+    break;
+  }
+
+  // Skewed column s = j + skew * (i - ibeg) - jbeg lies in [0, width)
+  auto width = cols + pln.skew * (rows - 1);
+  ntiles_j = (width + pln.tile_j - 1) / pln.tile_j;
+
+#pragma omp parallel
+  for (std::size_t wave = 0; wave < ntiles_i + ntiles_j - 1; ++wave) {
+    auto first = wave < ntiles_j ? 0 : wave - ntiles_j + 1,
+         last = std::min(wave + 1, ntiles_i);
+
+#pragma omp for schedule(dynamic)
+    for (auto ti = first; ti < last; ++ti) {
+      auto tj = wave - ti;
+      auto ib = nest.ibeg + ti * pln.tile_i,
+           ie = std::min(ib + pln.tile_i, nest.iend);
+
+      for (auto i = ib; i < ie; ++i) {
+        // tile columns [sb, se) mapped back to j and clipped
+        auto shift = pln.skew * (i - nest.ibeg);
+        auto sb = tj * pln.tile_j, se = sb + pln.tile_j;
+        auto jb = std::max(sb, shift), je = std::min(se, shift + cols);
+        if (jb < je)
+          body(i, nest.jbeg + jb - shift, nest.jbeg + je - shift);
+      }
+    }
+  }
+}
+
+} // namespace lab
+
+#endif // __INCLUDE_LOOPNEST_HH__
@@ -0,0 +1,176 @@
+#ifndef __INCLUDE_VSIN_HH__
+#define __INCLUDE_VSIN_HH__
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <string_view>
+
+#include <immintrin.h>
+
+namespace lab {
+
+// Row kernels dst[j] = sin(scale * src[j]), j < size; dst may be src.
+using RowSin = void (*)(double *dst, const double *src, std::size_t size,
+                        double scale);
+
+inline void sinRowLibm(double *dst, const double *src, std::size_t size,
+                       double scale) {
+  for (std::size_t j = 0; j < size; ++j)
+    dst[j] = std::sin(scale * src[j]);
+}
+
+namespace detail {
+
+// Beyond this the Cody-Waite reductions below lose bits, such lanes are
+// left to libm
+constexpr double REDUCE_LIMIT = 1 << 28;
+
+inline __m256d polyFma(__m256d x, __m256d acc, double coef) {
+  return _mm256_fmadd_pd(acc, x, _mm256_set1_pd(coef));
+}
+
+// About 1 ULP: x is reduced to z in [-pi/4, pi/4] by octant with pi/4
+// split in three parts, then sin or cos minimax polynomial of Cephes is
+// taken depending on the octant.
+inline __m256d sinUlp1(__m256d x) {
+  const auto sign_mask = _mm256_set1_pd(-0.0);
+  auto sign = _mm256_and_pd(x, sign_mask);
+  auto ax = _mm256_andnot_pd(sign_mask, x);
+
+  // even octant number y and its value modulo 8
+  auto y = _mm256_floor_pd(_mm256_mul_pd(ax, _mm256_set1_pd(4 / M_PI)));
+  auto half = _mm256_floor_pd(_mm256_mul_pd(y, _mm256_set1_pd(0.5)));
+  y = _mm256_add_pd(y, _mm256_sub_pd(y, _mm256_add_pd(half, half)));
+  auto eighth = _mm256_floor_pd(_mm256_mul_pd(y, _mm256_set1_pd(0.125)));
+  auto j8 = _mm256_sub_pd(y, _mm256_mul_pd(eighth, _mm256_set1_pd(8)));
+
+  auto neg = _mm256_cmp_pd(j8, _mm256_set1_pd(3), _CMP_GT_OQ);
+  auto j4 = _mm256_sub_pd(j8, _mm256_and_pd(neg, _mm256_set1_pd(4)));
+  auto use_cos = _mm256_cmp_pd(j4, _mm256_set1_pd(2), _CMP_EQ_OQ);
+
+  auto z = _mm256_fnmadd_pd(y, _mm256_set1_pd(7.85398125648498535156E-1), ax);
+  z = _mm256_fnmadd_pd(y, _mm256_set1_pd(3.77489470793079817668E-8), z);
+  z = _mm256_fnmadd_pd(y, _mm256_set1_pd(2.69515142907905952645E-15), z);
+  auto zz = _mm256_mul_pd(z, z);
+
+  auto ps = _mm256_set1_pd(1.58962301576546568060E-10);
+  ps = polyFma(zz, ps, -2.50507477628578072866E-8);
+  ps = polyFma(zz, ps, 2.75573136213857245213E-6);
+  ps = polyFma(zz, ps, -1.98412698295895385996E-4);
+  ps = polyFma(zz, ps, 8.33333333332211858878E-3);
+  ps = polyFma(zz, ps, -1.66666666666666307295E-1);
+  auto res_sin = _mm256_fmadd_pd(_mm256_mul_pd(z, zz), ps, z);
+
+  auto pc = _mm256_set1_pd(-1.13585365213876817300E-11);
+  pc = polyFma(zz, pc, 2.08757008419747316778E-9);
+  pc = polyFma(zz, pc, -2.75573141792967388112E-7);
+  pc = polyFma(zz, pc, 2.48015872888517045348E-5);
+  pc = polyFma(zz, pc, -1.38888888888730564116E-3);
+  pc = polyFma(zz, pc, 4.16666666666665929218E-2);
+  // 1 - zz / 2 rounds coarsely, its error is carried into the tail as in
+  // fdlibm's kernel_cos
+  auto hz = _mm256_mul_pd(zz, _mm256_set1_pd(0.5));
+  auto w = _mm256_sub_pd(_mm256_set1_pd(1), hz);
+  auto tail = _mm256_sub_pd(_mm256_sub_pd(_mm256_set1_pd(1), w), hz);
+  tail = _mm256_fmadd_pd(_mm256_mul_pd(zz, zz), pc, tail);
+  auto res_cos = _mm256_add_pd(w, tail);
+
+  auto res = _mm256_blendv_pd(res_sin, res_cos, use_cos);
+  sign = _mm256_xor_pd(sign, _mm256_and_pd(neg, sign_mask));
+  return _mm256_xor_pd(res, sign);
+}
+
+// About 1e-13 absolute: x = n pi + r, r in [-pi/2, pi/2] with two-part pi,
+// sin r by Taylor series up to r^17, sign flipped for odd n. No blends.
+inline __m256d sinFast(__m256d x) {
+  auto n = _mm256_round_pd(_mm256_mul_pd(x, _mm256_set1_pd(1 / M_PI)),
+                           _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+  auto r = _mm256_fnmadd_pd(n, _mm256_set1_pd(M_PI), x);
+  r = _mm256_fnmadd_pd(n, _mm256_set1_pd(1.2246467991473532e-16), r);
+  auto rr = _mm256_mul_pd(r, r);
+
+  auto p = _mm256_set1_pd(1 / 355687428096000.0);
+  p = polyFma(rr, p, -1 / 1307674368000.0);
+  p = polyFma(rr, p, 1 / 6227020800.0);
+  p = polyFma(rr, p, -1 / 39916800.0);
+  p = polyFma(rr, p, 1 / 362880.0);
+  p = polyFma(rr, p, -1 / 5040.0);
+  p = polyFma(rr, p, 1 / 120.0);
+  p = polyFma(rr, p, -1 / 6.0);
+  auto res = _mm256_fmadd_pd(_mm256_mul_pd(r, rr), p, r);
+
+  // n is integral, its parity decides the sign
+  auto half = _mm256_floor_pd(_mm256_mul_pd(n, _mm256_set1_pd(0.5)));
+  auto odd = _mm256_cmp_pd(n, _mm256_add_pd(half, half), _CMP_NEQ_OQ);
+  return _mm256_xor_pd(res, _mm256_and_pd(odd, _mm256_set1_pd(-0.0)));
+}
+
+// Every element is computed the same way wherever it is in the row, so
+// results do not depend on how rows are split between workers
+template <__m256d (*Kernel)(__m256d)> __m256d sinVec(__m256d x) {
+  auto ax = _mm256_andnot_pd(_mm256_set1_pd(-0.0), x);
+  auto big = _mm256_movemask_pd(
+      _mm256_cmp_pd(ax, _mm256_set1_pd(REDUCE_LIMIT), _CMP_NLE_UQ));
+  auto res = Kernel(x);
+  if (big == 0)
+    return res;
+
+  double xs[4], rs[4];
+  _mm256_storeu_pd(xs, x);
+  _mm256_storeu_pd(rs, res);
+  for (int l = 0; l < 4; ++l)
+    if (big & (1 << l))
+      rs[l] = std::sin(xs[l]);
+  return _mm256_loadu_pd(rs);
+}
+
+template <__m256d (*Kernel)(__m256d)>
+void sinRowSimd(double *dst, const double *src, std::size_t size,
+                double scale) {
+  std::size_t j = 0, end_j = size - size % 4;
+  auto scale_v = _mm256_set1_pd(scale);
+
+  for (; j < end_j; j += 4) {
+    auto x = _mm256_mul_pd(_mm256_loadu_pd(src + j), scale_v);
+    _mm256_storeu_pd(dst + j, sinVec<Kernel>(x));
+  }
+
+  if (j == size)
+    return;
+
+  double buf[4] = {};
+  std::copy(src + j, src + size, buf);
+  auto x = _mm256_mul_pd(_mm256_loadu_pd(buf), scale_v);
+  _mm256_storeu_pd(buf, sinVec<Kernel>(x));
+  std::copy(buf, buf + (size - j), dst + j);
+}
+
+} // namespace detail
+
+// <= 1 ULP versus correctly rounded sine on tested ranges
+inline void sinRowUlp1(double *dst, const double *src, std::size_t size,
+                       double scale) {
+  detail::sinRowSimd<detail::sinUlp1>(dst, src, size, scale);
+}
+
+// ~1e-13 absolute error, fewer operations per element
+inline void sinRowFast(double *dst, const double *src, std::size_t size,
+                       double scale) {
+  detail::sinRowSimd<detail::sinFast>(dst, src, size, scale);
+}
+
+// "libm", "ulp1" or "fast"; nullptr for other names
+inline RowSin rowSinByName(std::string_view name) {
+  if (name == "libm")
+    return sinRowLibm;
+  if (name == "ulp1")
+    return sinRowUlp1;
+  if (name == "fast")
+    return sinRowFast;
+  return nullptr;
+}
+
+} // namespace lab
+
+#endif // __INCLUDE_VSIN_HH__
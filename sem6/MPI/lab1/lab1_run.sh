@@ -1,10 +1,7 @@
 #! /usr/bin/bash
 
+# One launch per rank count, 100 runs in process; per-rank CSV on stdout
 for (( n = 1; n < 5; n++))
 do
-  echo "n = $n"
-  for (( i = 0; i < 100; i++))
-  do
-    mpirun -np $n ./lab1
-  done
+  mpirun -np $n ./lab1 res.txt bench=100 | tail -n +$(( n == 1 ? 1 : 2 ))
 done
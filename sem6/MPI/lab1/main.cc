@@ -1,31 +1,129 @@
 #include <algorithm>
+#include <array>
 #include <cmath>
 #include <cstddef>
 #include <fstream>
 #include <iostream>
+#include <limits>
+#include <optional>
+#include <stdexcept>
 #include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
 #include <vector>
 
+#include <immintrin.h>
 #include <mpi.h>
+#include <omp.h>
+
+#include "array2d.hh"
+#include "array2d_mpi.hh"
+#include "bench.hh"
+#include "bench_mpi.hh"
+#include "dump_mpi.hh"
+#include "loopnest.hh"
 
 using ldbl = long double;
 
-constexpr ldbl a = 1;
-constexpr ldbl h = 1e-3;
-constexpr ldbl tau = 1e-3;
-constexpr ldbl T = 1;
-constexpr ldbl X = 1;
-constexpr int K = T / tau + 1;
-constexpr int M = X / h + 1;
 constexpr ldbl PI = 3.14159265358979323846;
 
-ldbl f(ldbl x, ldbl t) { return t + x; }
+// Coefficients and grid of the current run: u_t + a u_x = f(x, t) on
+// [0, X] x [0, T], K time rows of M points, see setLevel
+ldbl a = 1;
+ldbl h = 1e-3;
+ldbl tau = 1e-3;
+ldbl T = 1;
+ldbl X = 1;
+std::size_t K = 0;
+std::size_t M = 0;
+
+// Built-in problems, "problem=NAME" on the command line: source f,
+// initial values phi(x) = u(x, 0), boundary values psi(t) = u(0, t) and,
+// for the ones with a known solution, the exact u
+enum class Problem {
+  // the lab task, no exact solution
+  Lab,
+  // u = sin(2 pi (x - a t))
+  Sine,
+  // u = exp(-t) cos(pi x), initial and boundary values of the lab task
+  Decay
+};
+
+struct LabProblem {
+  template <typename Real> static Real f(Real x, Real t) { return t + x; }
+  template <typename Real> static Real phi(Real x) {
+    return std::cos(static_cast<Real>(PI) * x);
+  }
+  template <typename Real> static Real psi(Real t) { return std::exp(-t); }
+};
+
+struct SineProblem {
+  template <typename Real> static Real exact(Real x, Real t) {
+    return std::sin(2 * static_cast<Real>(PI) * (x - static_cast<Real>(a) * t));
+  }
+  template <typename Real> static Real f(Real, Real) { return 0; }
+  template <typename Real> static Real phi(Real x) { return exact(x, Real(0)); }
+  template <typename Real> static Real psi(Real t) { return exact(Real(0), t); }
+};
+
+struct DecayProblem {
+  template <typename Real> static Real exact(Real x, Real t) {
+    return std::exp(-t) * std::cos(static_cast<Real>(PI) * x);
+  }
+  template <typename Real> static Real f(Real x, Real t) {
+    auto pi = static_cast<Real>(PI);
+    return -std::exp(-t) * (std::cos(pi * x) +
+                            static_cast<Real>(a) * pi * std::sin(pi * x));
+  }
+  template <typename Real> static Real phi(Real x) { return exact(x, Real(0)); }
+  template <typename Real> static Real psi(Real t) { return exact(Real(0), t); }
+};
+
+template <typename Real> struct Functions {
+  Real (*f)(Real, Real) = nullptr;
+  Real (*phi)(Real) = nullptr;
+  Real (*psi)(Real) = nullptr;
+  // nullptr if unknown
+  Real (*exact)(Real, Real) = nullptr;
+};
+
+template <typename P, typename Real> Functions<Real> functionsOf() {
+  Functions<Real> res{P::template f<Real>, P::template phi<Real>,
+                      P::template psi<Real>};
+  if constexpr (requires { P::template exact<Real>; })
+    res.exact = P::template exact<Real>;
+  return res;
+}
 
-ldbl phi(ldbl x) { return std::cos(PI * x); }
+template <typename Real> Functions<Real> functionsOf(Problem problem) {
+  switch (problem) {
+  case Problem::Sine:
+    return functionsOf<SineProblem, Real>();
+  case Problem::Decay:
+    return functionsOf<DecayProblem, Real>();
+  default:
+    return functionsOf<LabProblem, Real>();
+  }
+}
 
-ldbl psi(ldbl t) { return std::exp(-t); }
+// Coefficients of the scheme rounded to Real
+template <typename Real> struct Coef {
+  Real c, denom, two_tau;
+};
 
-void printRes(std::ostream &ost, const std::vector<ldbl> &res) {
+// Problem of the current run in each scalar type, see setLevel
+template <typename Real> Functions<Real> fns{};
+template <typename Real> Coef<Real> coef{};
+
+// The solver is computed in Real: float, double or long double, which is
+// also the reference for the accuracy report
+template <typename Real> Real f(Real x, Real t) { return fns<Real>.f(x, t); }
+template <typename Real> Real phi(Real x) { return fns<Real>.phi(x); }
+template <typename Real> Real psi(Real t) { return fns<Real>.psi(t); }
+
+template <typename Real>
+void printRes(std::ostream &ost, const lab::Array2D<Real> &res) {
   ost << "tau: " << tau << std::endl;
   ost << "h: " << h << std::endl;
   ost << "T: " << T << std::endl;
@@ -34,80 +132,751 @@ void printRes(std::ostream &ost, const std::vector<ldbl> &res) {
   ost << "K: " << K << std::endl;
 
   for (std::size_t i = 0, sz = K * M; i < sz; ++i)
-    ost << res[i] << std::endl;
+    ost << res.data()[i] << std::endl;
 }
 
-int main(int argc, char *argv[]) {
-  MPI::Init(argc, argv);
+// Source term of cell (k, m)
+template <typename Real> Real source(std::size_t k, std::size_t m) {
+  return f<Real>((m - Real(0.5)) * static_cast<Real>(h),
+                 (k - Real(0.5)) * static_cast<Real>(tau));
+}
+
+// Corner scheme: cur[m] = U[k][m] from U[k - 1][m], U[k - 1][m - 1] in
+// prev and U[k][m - 1]
+template <typename Real>
+void updateCell(Real *cur, const Real *prev, std::size_t k, std::size_t m) {
+  auto C = coef<Real>;
+  cur[m] = prev[m] + prev[m - 1] - cur[m - 1] -
+           C.c * (-cur[m - 1] + prev[m] - prev[m - 1]) +
+           C.two_tau * source<Real>(k, m);
+  cur[m] /= C.denom;
+}
+
+constexpr std::size_t LANES = 4;
+
+// Rows [k, k + 4) x columns [mbeg, mend) on doubles, mend - mbeg >= 4.
+// Cells of one anti-diagonal k + m do not depend on each other, so lane i
+// computes row k + i lagging i columns behind lane 0. The left, upper and
+// upper-left neighbours are the results of the last two steps shifted by
+// one lane, lane 0 reads them from row k - 1. The triangles at both ends,
+// where some lanes are outside the columns, are done cell by cell.
+void updateRowsSimd(lab::Array2D<double> &U, std::size_t k, std::size_t mbeg,
+                    std::size_t mend) {
+  auto C = coef<double>;
+
+  for (std::size_t i = 0; i + 1 < LANES; ++i)
+    for (auto m = mbeg; m < mbeg + LANES - 1 - i; ++m)
+      updateCell(U[k + i], U[k + i - 1], k + i, m);
+
+  // Lane i of step s holds U[k + i][mbeg + s - i]
+  auto lanes = [&U, k, mbeg](std::size_t s) {
+    std::array<double, LANES> res{};
+    for (std::size_t i = 0; i < LANES; ++i)
+      if (mbeg + s >= i)
+        res[i] = U[k + i][mbeg + s - i];
+    return _mm256_loadu_pd(res.data());
+  };
+  // [x, vec[0], vec[1], vec[2]]
+  auto shift = [](__m256d vec, double x) {
+    return _mm256_blend_pd(
+        _mm256_permute4x64_pd(vec, _MM_SHUFFLE(2, 1, 0, 0)),
+        _mm256_set1_pd(x), 0b0001);
+  };
+
+  auto prev2 = lanes(LANES - 3), prev1 = lanes(LANES - 2);
+  auto c_v = _mm256_set1_pd(C.c), denom_v = _mm256_set1_pd(C.denom),
+       two_tau_v = _mm256_set1_pd(C.two_tau);
+  std::array<double, LANES> src{}, res{};
+
+  for (auto m0 = mbeg + LANES - 1; m0 < mend; ++m0) {
+    for (std::size_t i = 0; i < LANES; ++i)
+      src[i] = source<double>(k + i, m0 - i);
+
+    auto up = shift(prev1, U[k - 1][m0]);
+    auto upleft = shift(prev2, U[k - 1][m0 - 1]);
+    auto left = prev1;
+
+    auto val = _mm256_sub_pd(_mm256_add_pd(up, upleft), left);
+    auto diff = _mm256_sub_pd(_mm256_sub_pd(up, left), upleft);
+    val = _mm256_sub_pd(val, _mm256_mul_pd(c_v, diff));
+    val = _mm256_add_pd(
+        val, _mm256_mul_pd(two_tau_v, _mm256_loadu_pd(src.data())));
+    val = _mm256_div_pd(val, denom_v);
+
+    _mm256_storeu_pd(res.data(), val);
+    for (std::size_t i = 0; i < LANES; ++i)
+      U[k + i][m0 - i] = res[i];
+
+    prev2 = prev1, prev1 = val;
+  }
+
+  for (std::size_t i = 1; i < LANES; ++i)
+    for (auto m = mend - i; m < mend; ++m)
+      updateCell(U[k + i], U[k + i - 1], k + i, m);
+}
+
+// Row k x columns [mbeg, mend) on doubles, for the solvers that hold a
+// single row at a time. Along a row the scheme is a first order recurrence
+// cur[m] = b[m] + r cur[m - 1] with r = (c - 1) / denom and
+// b[m] = ((1 - c) prev[m] + (1 + c) prev[m - 1] + 2 tau f) / denom, so b is
+// computed 4 cells at a time and the recurrence by a 4-lane scan with the
+// powers of r. Unlike updateRowsSimd it rounds differently from
+// updateCell, in the last bits.
+void updateRowScan(double *cur, const double *prev, std::size_t k,
+                   std::size_t mbeg, std::size_t mend) {
+  auto C = coef<double>;
+  auto r = (C.c - 1) / C.denom;
+  auto cur_v = _mm256_set1_pd((1 - C.c) / C.denom),
+       left_v = _mm256_set1_pd((1 + C.c) / C.denom),
+       src_v = _mm256_set1_pd(C.two_tau / C.denom);
+  auto r_v = _mm256_set1_pd(r), r2_v = _mm256_set1_pd(r * r),
+       carry_v = _mm256_set_pd(r * r * r * r, r * r * r, r * r, r);
+  auto zero = _mm256_setzero_pd();
+  std::array<double, LANES> src{};
+
+  auto m = mbeg;
+  for (; m + LANES <= mend; m += LANES) {
+    for (std::size_t i = 0; i < LANES; ++i)
+      src[i] = source<double>(k, m + i);
 
-  std::vector<std::vector<ldbl>> U{};
-  U.resize(K);
-  for (auto &row : U)
-    row.resize(M);
+    auto val = _mm256_mul_pd(left_v, _mm256_loadu_pd(prev + m - 1));
+    val = _mm256_fmadd_pd(cur_v, _mm256_loadu_pd(prev + m), val);
+    val = _mm256_fmadd_pd(src_v, _mm256_loadu_pd(src.data()), val);
+
+    // val[i] += r val[i - 1], then val[i] += r^2 val[i - 2]
+    auto by1 = _mm256_blend_pd(
+        _mm256_permute4x64_pd(val, _MM_SHUFFLE(2, 1, 0, 0)), zero, 0b0001);
+    val = _mm256_fmadd_pd(r_v, by1, val);
+    auto by2 = _mm256_permute2f128_pd(val, val, 0x08);
+    val = _mm256_fmadd_pd(r2_v, by2, val);
+
+    val = _mm256_fmadd_pd(carry_v, _mm256_set1_pd(cur[m - 1]), val);
+    _mm256_storeu_pd(cur + m, val);
+  }
+
+  for (; m < mend; ++m)
+    updateCell(cur, prev, k, m);
+}
+
+// Row k x columns [mbeg, mend), given row k - 1 and column mbeg - 1
+template <typename Real>
+void updateRow(Real *cur, const Real *prev, std::size_t k, std::size_t mbeg,
+               std::size_t mend) {
+  if constexpr (std::is_same_v<Real, double>)
+    updateRowScan(cur, prev, k, mbeg, mend);
+  else
+    for (auto m = mbeg; m < mend; ++m)
+      updateCell(cur, prev, k, m);
+}
+
+// Rows [kbeg, kend) x columns [mbeg, mend), given row kbeg - 1 and column
+// mbeg - 1. Doubles go 4 rows at a time through updateRowsSimd, the rows
+// left over through updateRowScan.
+template <typename Real>
+void updateBlock(lab::Array2D<Real> &U, std::size_t kbeg, std::size_t kend,
+                 std::size_t mbeg, std::size_t mend) {
+  auto k = kbeg;
+  if constexpr (std::is_same_v<Real, double>)
+    if (mend - mbeg >= LANES)
+      for (; k + LANES <= kend; k += LANES)
+        updateRowsSimd(U, k, mbeg, mend);
+
+  for (; k < kend; ++k)
+    updateRow(U[k], U[k - 1], k, mbeg, mend);
+}
+
+// Time-skewed tiling on one rank: distances of the scheme in (k, m) are
+// (1, 0), (1, 1), (0, 1), so tiles of several time steps by a part of the
+// grid are legal. They run as a wavefront on OpenMP threads, and every
+// tile is done while its rows are still in cache.
+constexpr std::size_t TILE_K = 32;
+constexpr std::size_t TILE_M = 256;
+
+template <typename Real> void solveTiled(lab::Array2D<Real> &U) {
+  lab::LoopNest2D nest{1, K, 1, M, {{1, 0}, {1, 1}, {0, 1}}, false,
+                       TILE_K, TILE_M};
+  lab::run(nest, [&U](auto k, auto mb, auto me) {
+    updateRow(U[k], U[k - 1], k, mb, me);
+  });
+}
+
+template <typename Real> void initGrid(lab::Array2D<Real> &U) {
+  U = lab::Array2D<Real>{K, M};
 
   // Fill initial values
   for (std::size_t k = 0; k < K; ++k)
-    U[k][0] = psi(k * tau);
+    U[k][0] = psi<Real>(k * static_cast<Real>(tau));
 
   for (std::size_t m = 0; m < M; ++m)
-    U[0][m] = phi(m * h);
+    U[0][m] = phi<Real>(m * static_cast<Real>(h));
+}
+
+// Part of len pipelined as one message, e.g. "block=B". 0 gives about 8
+// parts per rank, so the pipeline fills after a small share of the work.
+std::size_t chunkSize(std::size_t chunk, std::size_t len, int commsize) {
+  if (chunk != 0)
+    return std::min(chunk, len);
+  return std::max<std::size_t>(len / (8 * commsize), 1);
+}
+
+// Rows of the whole grid
+template <typename Real> struct GridRows {
+  lab::Array2D<Real> &U;
+
+  Real *operator()(std::size_t k) { return U[k]; }
+  void start(std::size_t) {}
+  void done(std::size_t) {}
+};
+
+// Rolling window of the rows a rank needs in the row pipeline: two of its
+// own rows (one may still be being sent) and the previous row received
+// from the neighbour. Every every-th row is streamed to out once done, so
+// memory per rank is O(M) for any K.
+template <typename Real> class WindowRows final {
+  int rank_, commsize_;
+  std::array<std::vector<Real>, 2> own_{std::vector<Real>(M),
+                                        std::vector<Real>(M)};
+  std::vector<Real> recv_ = std::vector<Real>(M);
+  lab::RowStream<Real> &out_;
+  std::size_t every_;
+
+public:
+  WindowRows(int rank, int commsize, lab::RowStream<Real> &out,
+             std::size_t every)
+      : rank_(rank), commsize_(commsize), out_(out), every_(every) {}
+
+  Real *operator()(std::size_t k) {
+    if (commsize_ == 1 || static_cast<int>(k % commsize_) == rank_)
+      return own_[k / commsize_ % 2].data();
+    return recv_.data();
+  }
+
+  // Boundary values of row k and of the previous row, which is received
+  // without them
+  void start(std::size_t k) {
+    auto cur = (*this)(k);
+    if (k == 0) {
+      for (std::size_t m = 0; m < M; ++m)
+        cur[m] = phi<Real>(m * static_cast<Real>(h));
+      return;
+    }
+    cur[0] = psi<Real>(k * static_cast<Real>(tau));
+    (*this)(k - 1)[0] = psi<Real>((k - 1) * static_cast<Real>(tau));
+  }
+
+  void done(std::size_t k) {
+    if (k % every_ == 0)
+      out_.write(k / every_, (*this)(k));
+  }
+};
+
+// Rows k = rank, rank + commsize, ... are computed by rank. A row is done
+// in blocks of B cells; every block goes to the rank of the next row in
+// one non-blocking message, while the next block of the previous row is
+// already being received.
+template <typename Real, typename Rows>
+void solvePipeline(Rows &rows, lab::PhaseTimer &timer, std::size_t B) {
+  auto rank = MPI::COMM_WORLD.Get_rank();
+  auto commsize = MPI::COMM_WORLD.Get_size();
+  auto prev = rank ? rank - 1 : commsize - 1, next = (rank + 1) % commsize;
+  auto type = lab::mpiType<Real>();
+
+  auto nblocks = (M - 1 + B - 1) / B;
+  auto blockBeg = [B](std::size_t b) { return 1 + b * B; };
+  auto blockLen = [B](std::size_t b) {
+    return std::min<std::size_t>(1 + (b + 1) * B, M) - (1 + b * B);
+  };
+
+  // Sends of a row are completed after the next row of the rank, their
+  // data are never written again
+  std::vector<MPI::Request> sreq{}, prev_sreq{};
+  std::array<MPI::Request, 2> rreq;
+
+  for (std::size_t k = rank; k < K; k += commsize) {
+    // A single rank has the previous row at hand; nobody receives the
+    // last row, it must not stay queued for the next run
+    bool recv = commsize > 1 && k != 0, send = commsize > 1 && k + 1 < K;
+    auto postRecv = [&](std::size_t b) {
+      rreq[b % 2] = MPI::COMM_WORLD.Irecv(rows(k - 1) + blockBeg(b),
+                                          blockLen(b), type, prev, b);
+    };
+
+    rows.start(k);
+    if (recv)
+      postRecv(0);
+
+    for (std::size_t b = 0; b < nblocks; ++b) {
+      if (recv) {
+        if (b + 1 < nblocks)
+          postRecv(b + 1);
+        timer.time(lab::Phase::Comm, [&] { rreq[b % 2].Wait(); });
+      }
+
+      auto mbeg = blockBeg(b), mend = mbeg + blockLen(b);
+      if (k != 0)
+        updateRow(rows(k), rows(k - 1), k, mbeg, mend);
 
+      if (send)
+        sreq.push_back(MPI::COMM_WORLD.Isend(rows(k) + mbeg, blockLen(b),
+                                             type, next, b));
+    }
+    timer.time(lab::Phase::Output, [&] { rows.done(k); });
+
+    timer.time(lab::Phase::Comm, [&] {
+      MPI::Request::Waitall(prev_sreq.size(), prev_sreq.data());
+    });
+    prev_sreq = std::move(sreq);
+    sreq.clear();
+  }
+
+  timer.time(lab::Phase::Comm, [&] {
+    MPI::Request::Waitall(prev_sreq.size(), prev_sreq.data());
+  });
+}
+
+// Rows k = r, r + commsize, ... of the row pipeline go to rank 0 as one
+// strided message
+template <typename Real>
+void gatherRows(lab::Array2D<Real> &U, lab::PhaseTimer &timer) {
   auto rank = MPI::COMM_WORLD.Get_rank();
   auto commsize = MPI::COMM_WORLD.Get_size();
 
-  MPI::COMM_WORLD.Barrier();
-  auto tic = MPI::Wtime();
-
-  for (auto k = rank; k < K; k += commsize)
-    for (int m = 1; m < M; ++m) {
-      if (k != 0) {
-        MPI::COMM_WORLD.Recv(&(U[k - 1][m]), 1, MPI::LONG_DOUBLE,
-                             rank ? rank - 1 : commsize - 1, m);
-
-        auto fVal = f((m - 0.5) * h, (k - 0.5) * tau);
-        U[k][m] =
-            U[k - 1][m] + U[k - 1][m - 1] - U[k][m - 1] -
-            a * tau / h *
-                (-U[k][m - 1] + U[k - 1][m] - U[k - 1][m - 1]) +
-            2 * tau * fVal;
-        U[k][m] /= 1 + a * tau / h;
+  auto rowsOf = [&U, commsize](int r) {
+    std::size_t nrows = (K - r + commsize - 1) / commsize;
+    return lab::View2D<Real>{U[r], nrows, M,
+                             static_cast<std::size_t>(commsize) * M};
+  };
+
+  timer.time(lab::Phase::Comm, [&] {
+    if (rank != 0 && static_cast<std::size_t>(rank) < K) {
+      auto rows = rowsOf(rank);
+      MPI::COMM_WORLD.Send(rows.ptr, 1, lab::viewType(rows), 0, M);
+    } else if (rank == 0)
+      for (int r = 1; r < std::min(commsize, static_cast<int>(K)); ++r) {
+        auto rows = rowsOf(r);
+        MPI::COMM_WORLD.Recv(rows.ptr, 1, lab::viewType(rows), r, M);
       }
+  });
+}
+
+// Columns [1, M) are split into contiguous strips, rank r owning strip r
+// for all time rows. Cell (k, m) needs (k, m - 1), so the strips form a
+// pipeline along x: a rank computes KT rows of its strip once the left
+// neighbour has sent the last column of these rows, one message of KT
+// values per (k, m) tile, and the tiles of all ranks proceed as a
+// diagonal wavefront. KT = 1 is a halo exchange of one value per step.
+// The strips are then collected on rank 0.
+template <typename Real>
+void solveStrips(lab::Array2D<Real> &U, lab::PhaseTimer &timer,
+                 std::size_t KT) {
+  auto rank = MPI::COMM_WORLD.Get_rank();
+  auto commsize = MPI::COMM_WORLD.Get_size();
+
+  auto stripBeg = [commsize](int r) { return 1 + (M - 1) * r / commsize; };
+  std::size_t mbeg = stripBeg(rank), mend = stripBeg(rank + 1);
+  bool has_left = rank > 0, has_right = rank + 1 < commsize;
 
-      MPI::COMM_WORLD.Send(&(U[k][m]), 1, MPI::LONG_DOUBLE,
-                           (k + 1) % commsize, m);
+  auto ntiles = (K - 1 + KT - 1) / KT;
+  auto tileBeg = [KT](std::size_t t) { return 1 + t * KT; };
+  auto tileEnd = [KT](std::size_t t) {
+    return std::min<std::size_t>(1 + (t + 1) * KT, K);
+  };
+  // Column m of the rows of tile t, to be used with U.data()
+  auto columnType = [&U, &tileBeg, &tileEnd](std::size_t t, std::size_t m) {
+    return lab::subarrayType(U, tileBeg(t), m, tileEnd(t) - tileBeg(t), 1);
+  };
+
+  std::array<MPI::Request, 2> rreq;
+  std::vector<MPI::Request> sreq{};
+  auto postRecv = [&](std::size_t t) {
+    rreq[t % 2] = MPI::COMM_WORLD.Irecv(U.data(), 1, columnType(t, mbeg - 1),
+                                        rank - 1, t);
+  };
+
+  if (has_left)
+    postRecv(0);
+
+  for (std::size_t t = 0; t < ntiles; ++t) {
+    if (has_left) {
+      if (t + 1 < ntiles)
+        postRecv(t + 1);
+      timer.time(lab::Phase::Comm, [&] { rreq[t % 2].Wait(); });
     }
 
-  std::vector<ldbl> res{};
-  // Fill K in a way that commsize becomes it's factor
-  auto filledK = K + (commsize - K % commsize) % commsize;
-  if (rank == 0)
-    res.resize(filledK * M);
+    updateBlock(U, tileBeg(t), tileEnd(t), mbeg, mend);
 
-  // Dummy vector for free processors
-  std::vector<ldbl> empty(M, 0);
+    if (has_right)
+      sreq.push_back(MPI::COMM_WORLD.Isend(U.data(), 1, columnType(t, mend - 1),
+                                           rank + 1, t));
+  }
 
-  for (auto k = rank; k < filledK; k += commsize) {
-    if (commsize > 1) {
-      auto *src = k < K ? U[k].data() : empty.data();
+  timer.time(lab::Phase::Comm, [&] {
+    MPI::Request::Waitall(sreq.size(), sreq.data());
 
-      MPI::COMM_WORLD.Gather(src, M, MPI::LONG_DOUBLE, res.data() + k * M,
-                             M, MPI::LONG_DOUBLE, 0);
-    } else if (k < K)
-      std::copy(U[k].begin(), U[k].end(), res.begin() + k * M);
+    auto stripType = [&U, &stripBeg](int r) {
+      return lab::subarrayType(U, 0, stripBeg(r), K,
+                               stripBeg(r + 1) - stripBeg(r));
+    };
+    if (rank != 0)
+      MPI::COMM_WORLD.Send(U.data(), 1, stripType(rank), 0, K);
     else
-      break;
+      for (int r = 1; r < commsize; ++r)
+        MPI::COMM_WORLD.Recv(U.data(), 1, stripType(r), r, K);
+  });
+}
+
+// Differences of a solution from the long double one; rel is max_abs over
+// the largest value, the solution crosses zero
+struct Accuracy {
+  ldbl max_abs = 0, rel = 0, rms = 0;
+};
+
+template <typename Real> Accuracy accuracy(const lab::Array2D<Real> &U) {
+  lab::Array2D<ldbl> ref{};
+  initGrid(ref);
+  updateBlock(ref, 1, K, 1, M);
+
+  Accuracy res{};
+  ldbl max_ref = 0;
+  for (std::size_t i = 0, sz = K * M; i < sz; ++i) {
+    ldbl want = ref.data()[i], diff = std::abs(U.data()[i] - want);
+    res.max_abs = std::max(res.max_abs, diff);
+    max_ref = std::max(max_ref, std::abs(want));
+    res.rms += diff * diff;
+  }
+  res.rel = res.max_abs / max_ref;
+  res.rms = std::sqrt(res.rms / (K * M));
+  return res;
+}
+
+// Errors below this are rounding of Real accumulated over the grid, e.g.
+// sine at Courant number a tau / h = 1, where the scheme is exact, and say
+// nothing about the order
+template <typename Real> ldbl roundoffError() {
+  return std::numeric_limits<Real>::epsilon() * std::max(K, M);
+}
+
+// Largest difference of a solution from the exact one, if known
+template <typename Real> ldbl exactError(const lab::Array2D<Real> &U) {
+  auto exact = fns<ldbl>.exact;
+  ldbl res = 0;
+  for (std::size_t k = 0; k < K; ++k)
+    for (std::size_t m = 0; m < M; ++m)
+      res = std::max(res, std::abs(U[k][m] - exact(m * h, k * tau)));
+  return res;
+}
+
+enum class Solver {
+  // time rows round-robin over ranks, see solvePipeline
+  Rows,
+  // x strips, see solveStrips
+  Strips,
+  // one rank, see solveTiled
+  Tiles
+};
+
+struct Options {
+  std::string name = "res.txt";
+  Solver solver = Solver::Rows;
+  bool wave = false, window = false, accuracy = false;
+  std::size_t block = 0, ktile = 0, every = 1;
+  std::string real = "ldbl";
+  // Problem on the coarsest grid; level l of the sweep halves h and tau
+  // l times
+  Problem problem = Problem::Lab;
+  ldbl a = 1, h = 1e-3, tau = 1e-3, T = 1, X = 1;
+  std::size_t levels = 1;
+  lab::BenchArgs args{};
+};
+
+template <typename Real> void setFunctions(Problem problem) {
+  fns<Real> = functionsOf<Real>(problem);
+  coef<Real> = {static_cast<Real>(a * tau / h),
+                static_cast<Real>(1 + a * tau / h),
+                static_cast<Real>(2 * tau)};
+}
+
+// Sets the globals for level of the sweep. "size=KxM" fixes the points,
+// otherwise they follow from h and tau.
+void setLevel(const Options &opts, std::size_t level) {
+  a = opts.a, T = opts.T, X = opts.X;
+  std::size_t k0 = opts.args.rows, m0 = opts.args.cols;
+  if (opts.args.rows != 0)
+    tau = T / (k0 - 1), h = X / (m0 - 1);
+  else {
+    tau = opts.tau, h = opts.h;
+    k0 = static_cast<std::size_t>(T / tau + 1);
+    m0 = static_cast<std::size_t>(X / h + 1);
+  }
+
+  auto scale = std::size_t{1} << level;
+  tau /= scale, h /= scale;
+  K = (k0 - 1) * scale + 1, M = (m0 - 1) * scale + 1;
+
+  setFunctions<float>(opts.problem);
+  setFunctions<double>(opts.problem);
+  setFunctions<ldbl>(opts.problem);
+}
+
+template <typename Real> std::string_view realName() {
+  if constexpr (std::is_same_v<Real, float>)
+    return "float";
+  else if constexpr (std::is_same_v<Real, double>)
+    return "double";
+  else
+    return "ldbl";
+}
+
+template <typename Real> void run(const Options &opts) {
+  auto rank = MPI::COMM_WORLD.Get_rank();
+  auto commsize = MPI::COMM_WORLD.Get_size();
+
+  // Without "bench" the solver runs once per level and prints its time;
+  // with it the report stays the only output on stdout
+  auto cfg = opts.args.bench ? opts.args.cfg : lab::BenchConfig{0, 1};
+  cfg.sync = [] { MPI::COMM_WORLD.Barrier(); };
+  auto &log = opts.args.bench ? std::clog : std::cout;
+
+  std::vector<lab::BenchRecord> records{};
+  ldbl prev_error = 0;
+  bool prev_roundoff = false;
+  for (std::size_t level = 0; level < opts.levels; ++level) {
+    setLevel(opts, level);
+    auto block = chunkSize(opts.block, M - 1, commsize);
+    auto ktile = opts.wave ? chunkSize(opts.ktile, K - 1, commsize) : 1;
+
+    std::string solver_name = "tiles";
+    if (opts.solver == Solver::Rows)
+      solver_name =
+          (opts.window ? "window-b" : "rows-b") + std::to_string(block);
+    else if (opts.solver == Solver::Strips)
+      solver_name = opts.wave ? "wave-k" + std::to_string(ktile) : "x";
+    solver_name += "-" + std::string{realName<Real>()};
+
+    lab::Array2D<Real> U{};
+    lab::BenchCase bc{[&U] { initGrid(U); },
+                      [&U, &opts, block, ktile](lab::PhaseTimer &timer) {
+                        switch (opts.solver) {
+                        case Solver::Rows: {
+                          GridRows<Real> rows{U};
+                          solvePipeline<Real>(rows, timer, block);
+                          gatherRows(U, timer);
+                          break;
+                        }
+                        case Solver::Strips:
+                          solveStrips(U, timer, ktile);
+                          break;
+                        case Solver::Tiles:
+                          solveTiled(U);
+                          break;
+                        }
+                      },
+                      [&U, &opts, rank] {
+                        if (rank != 0)
+                          return;
+                        std::ofstream f(opts.name);
+                        printRes(f, U);
+                      }};
+
+    if (opts.window)
+      bc = {[] {}, [&opts, rank, commsize, block](lab::PhaseTimer &timer) {
+              std::optional<lab::RowStream<Real>> out{};
+              timer.time(lab::Phase::Output, [&] {
+                out.emplace(MPI::COMM_WORLD, opts.name,
+                            (K + opts.every - 1) / opts.every, M);
+              });
+
+              WindowRows<Real> rows{rank, commsize, *out, opts.every};
+              solvePipeline<Real>(rows, timer, block);
+              timer.time(lab::Phase::Output, [&] { out.reset(); });
+            }};
+
+    lab::BenchRecord rec{solver_name,
+                         rank,
+                         commsize,
+                         omp_get_max_threads(),
+                         static_cast<std::size_t>(K),
+                         static_cast<std::size_t>(M),
+                         cfg.repeats,
+                         lab::runBench(bc, cfg)};
+    auto all = lab::gatherRecords(MPI::COMM_WORLD, rec);
+    records.insert(records.end(), all.begin(), all.end());
+
+    if (rank != 0)
+      continue;
+
+    if (opts.levels > 1)
+      log << "Grid " << K << "x" << M << ":" << std::endl;
+    if (!opts.args.bench) {
+      auto &&stats = rec.stats;
+      auto sec = stats[static_cast<std::size_t>(lab::Phase::Compute)].median +
+                 stats[static_cast<std::size_t>(lab::Phase::Comm)].median;
+      std::cout << "Elapsed time " << sec << " s." << std::endl;
+    }
+
+    if (opts.accuracy) {
+      auto acc = accuracy(U);
+      log << "Accuracy of " << realName<Real>() << " vs long double: max abs "
+          << acc.max_abs << ", rel " << acc.rel << ", rms " << acc.rms
+          << std::endl;
+    }
+
+    // The convergence order of the scheme from the error on two grids
+    if (fns<ldbl>.exact != nullptr && !opts.window) {
+      auto error = exactError(U);
+      bool roundoff = error <= roundoffError<Real>();
+      log << "Error vs exact solution " << error;
+      if (roundoff)
+        log << ", at round-off level";
+      if (level != 0 && !roundoff && !prev_roundoff)
+        log << ", order " << std::log2(prev_error / error);
+      log << std::endl;
+      prev_error = error, prev_roundoff = roundoff;
+    }
+  }
+
+  if (opts.args.bench && rank == 0)
+    lab::writeReport(std::cout, records, opts.args.fmt);
+}
+
+// Applies one option to opts, throws std::invalid_argument
+void parseOption(std::string_view arg, Options &opts) {
+  auto value = [arg](std::string_view key) {
+    return arg.substr(key.size());
+  };
+  auto real = [&value](std::string_view key) {
+    return lab::parseReal(value(key));
+  };
+
+  if (arg == "tiles")
+    opts.solver = Solver::Tiles;
+  else if (arg == "decomp=rows")
+    opts.solver = Solver::Rows;
+  else if (arg == "decomp=x" || arg == "decomp=wave")
+    opts.solver = Solver::Strips, opts.wave = arg == "decomp=wave";
+  else if (arg.starts_with("block="))
+    opts.block = lab::parseCount(value("block="));
+  else if (arg.starts_with("ktile="))
+    opts.ktile = lab::parseCount(value("ktile="));
+  else if (arg == "window")
+    opts.window = true;
+  else if (arg.starts_with("every="))
+    opts.every = std::max<std::size_t>(lab::parseCount(value("every=")), 1);
+  else if (arg == "real=float" || arg == "real=double" || arg == "real=ldbl")
+    opts.real = value("real=");
+  else if (arg == "accuracy")
+    opts.accuracy = true;
+  else if (arg == "problem=lab")
+    opts.problem = Problem::Lab;
+  else if (arg == "problem=sine")
+    opts.problem = Problem::Sine;
+  else if (arg == "problem=decay")
+    opts.problem = Problem::Decay;
+  else if (arg.starts_with("a="))
+    opts.a = real("a=");
+  else if (arg.starts_with("h="))
+    opts.h = real("h=");
+  else if (arg.starts_with("tau="))
+    opts.tau = real("tau=");
+  else if (arg.starts_with("T="))
+    opts.T = real("T=");
+  else if (arg.starts_with("X="))
+    opts.X = real("X=");
+  else if (arg.starts_with("sweep="))
+    opts.levels = std::max<std::size_t>(lab::parseCount(value("sweep=")), 1);
+  else if (arg.starts_with("config=")) {
+    std::string name{value("config=")};
+    std::ifstream in{name};
+    if (!in)
+      throw std::invalid_argument{"Cannot open config " + name};
+    for (std::string word; in >> word;)
+      if (word.starts_with('#'))
+        std::getline(in, word);
+      else
+        parseOption(word, opts);
+  } else if (!lab::parseBenchArg(arg, opts.args))
+    throw std::invalid_argument{"Unknown option " + std::string{arg}};
+}
+
+int main(int argc, char *argv[]) {
+  MPI::Init(argc, argv);
+  auto rank = MPI::COMM_WORLD.Get_rank();
+  auto commsize = MPI::COMM_WORLD.Get_size();
+
+  // argv[1]: output file, then
+  // "decomp=rows|x|wave": time rows pipelined over ranks (default), x
+  //   strips with a one value halo per step, x strips exchanging KT rows
+  //   of halo at once
+  // "tiles": time-skewed tiles on a single rank
+  // "block=B": cells per message of the rows pipeline, 0 or none to pick
+  //   automatically
+  // "ktile=KT": rows per message of the wave, same default
+  // "window": rows pipeline keeping only the rows it needs; every
+  //   "every=N"-th row (1 by default) is streamed to the output file as a
+  //   binary dump (see dump.hh) instead of the text output
+  // "real=float|double|ldbl": scalar type, long double by default; double
+  //   is vectorized, 4 rows at a time in the wave with ktile >= 4 and
+  //   along single rows everywhere else
+  // "accuracy": compare the result with a long double solution
+  // "problem=lab|sine|decay": see Problem; sine and decay also print the
+  //   error against the exact solution and the order from the last grid,
+  //   unless the error is at round-off level (sine at a tau = h)
+  // "a=", "h=", "tau=", "T=", "X=": coefficient and grid, 1, 1e-3, 1e-3,
+  //   1, 1 by default; "size=KxM" sets the points instead of h and tau
+  // "sweep=N": solve on N grids, halving h and tau each time, for
+  //   convergence and scaling runs; the output file holds the last one
+  // "config=FILE": options from FILE, separated by spaces or newlines,
+  //   "#" starts a comment
+  // "bench=N", "warmup=N", "report=csv|json": see bench.hh
+  Options opts{};
+  if (argc > 1)
+    opts.name = argv[1];
+  try {
+    for (int i = 2; i < argc; ++i)
+      parseOption(argv[i], opts);
+  } catch (const std::invalid_argument &err) {
+    if (rank == 0)
+      std::cerr << err.what() << std::endl;
+    MPI::Finalize();
+    return 1;
   }
 
-  MPI::COMM_WORLD.Barrier();
-  auto toc = MPI::Wtime();
+  std::string_view error{};
+  if (!(opts.a > 0 && opts.h > 0 && opts.tau > 0 && opts.T > 0 && opts.X > 0))
+    error = "a, h, tau, T and X must be positive";
+  else if (opts.args.rows != 0 && (opts.args.rows < 2 || opts.args.cols < 2))
+    error = "Grid must have at least 2x2 points";
+  else if (opts.args.rows == 0 &&
+           (opts.T / opts.tau + 1 < 2 || opts.X / opts.h + 1 < 2))
+    error = "Grid must have at least 2x2 points";
+  else if (opts.solver == Solver::Tiles && commsize != 1)
+    error = "Tiles mode runs on a single rank";
+  else if (opts.window && opts.solver != Solver::Rows)
+    error = "Window mode needs the rows pipeline";
+  else if (opts.window && opts.accuracy)
+    error = "Window mode keeps no grid to check accuracy of";
+
+  if (error.empty()) {
+    setLevel(opts, 0);
+    if (opts.solver == Solver::Strips &&
+        static_cast<std::size_t>(commsize) > M - 1)
+      error = "Too many processes for x strips";
+  }
 
-  if (rank == 0) {
-    std::cout << "Elapsed time " << toc - tic << " s." << std::endl;
-    std::string name = argc > 1 ? argv[1] : "res.txt";
-    std::ofstream f(name);
-    printRes(f, res);
+  if (!error.empty()) {
+    if (rank == 0)
+      std::cerr << error << std::endl;
+    MPI::Finalize();
+    return 1;
   }
 
+  if (opts.real == "float")
+    run<float>(opts);
+  else if (opts.real == "double")
+    run<double>(opts);
+  else
+    run<ldbl>(opts);
+
   MPI::Finalize();
   return 0;
 }
@@ -0,0 +1,497 @@
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <limits>
+#include <utility>
+#include <vector>
+
+#include <mpi/mpi.h>
+#include <omp.h>
+
+#include "matmul.hh"
+#include "rand.hh"
+
+// Distributed Strassen in the spirit of CAPS (Ballard et al. 2012).
+// Matrices are padded to BLOCK * 2^L and stored as a Z-order sequence of
+// BLOCK x BLOCK blocks, so a quadrant on any recursion level is a range of
+// blocks. Every block is split between the ranks of the communicator into
+// nearly equal ranges of its row-major elements, and each rank holds only
+// its range of every block of A, B and C. The sums forming Strassen
+// operands and combining products are then local on every level.
+// On each level the seven sub-products are either
+//   BFS: given to seven disjoint groups of ranks, computed simultaneously;
+//        operands are moved into the group layouts by one Alltoallv and
+//        products moved back by another;
+//   DFS: computed one after another by all ranks of the communicator,
+//        without communication.
+// BFS needs memory for all seven operand pairs at once, so it is taken
+// only if that fits into the per-rank limit. A single rank multiplies
+// its matrices with the node-local OMP Strassen; a leaf block on several
+// ranks is gathered by them and split by rows.
+
+using mul::Mat;
+using Buf = std::vector<std::int32_t>;
+
+constexpr int NSUB = 7;
+
+struct Config {
+  // max side of the leaf blocks
+  std::size_t leaf = 256;
+  // per-rank memory limit in matrix elements
+  std::size_t mem_limit = std::numeric_limits<std::size_t>::max();
+};
+
+// Side of the leaf blocks of the current run
+std::size_t BLOCK = 0;
+
+// Elements [beg, end) of every block held by rank r of p
+std::pair<std::size_t, std::size_t> chunkOf(int r, int p) {
+  auto sz = BLOCK * BLOCK;
+  return {sz * r / p, sz * (r + 1) / p};
+}
+
+std::size_t chunkLen(int r, int p) {
+  auto [beg, end] = chunkOf(r, p);
+  return end - beg;
+}
+
+// Common part of two element ranges, empty if hi <= lo
+std::pair<std::size_t, std::size_t>
+overlap(std::pair<std::size_t, std::size_t> lhs,
+        std::pair<std::size_t, std::size_t> rhs) {
+  return {std::max(lhs.first, rhs.first), std::min(lhs.second, rhs.second)};
+}
+
+// (block row, block column) of block z of the Z order: quadrants go in
+// order 11, 12, 21, 22, two bits of z per level
+std::pair<std::size_t, std::size_t> blockPos(std::size_t z) {
+  std::size_t bi = 0, bj = 0;
+  for (std::size_t bit = 0; z != 0; ++bit, z >>= 2) {
+    bj |= (z & 1) << bit;
+    bi |= (z >> 1 & 1) << bit;
+  }
+  return {bi, bj};
+}
+
+std::size_t blockIdx(std::size_t bi, std::size_t bj) {
+  std::size_t z = 0;
+  for (std::size_t bit = 0; (bi | bj) != 0; bit += 2, bi >>= 1, bj >>= 1)
+    z |= (bj & 1) << bit | (bi & 1) << (bit + 1);
+  return z;
+}
+
+// Blocks per side of nblk blocks
+std::size_t blockSide(std::size_t nblk) {
+  std::size_t side = 1;
+  while (side * side < nblk)
+    side *= 2;
+  return side;
+}
+
+// Rank's part of n x n random matrix padded to nblk blocks. Values are
+// those of rnd::randMatrix with the same seed: every row a rank needs is
+// generated on its own, and no rank ever holds the whole matrix.
+Buf generate(std::size_t n, std::size_t nblk, std::uint64_t seed,
+             MPI::Intracomm &comm) {
+  auto [beg, end] = chunkOf(comm.Get_rank(), comm.Get_size());
+  auto len = end - beg, side = blockSide(nblk);
+  rnd::Uniform<std::int32_t> dist{-10, 10};
+  Buf res(nblk * len);
+
+#pragma omp parallel
+  {
+    Buf row(n);
+    std::vector<std::uint32_t> buf{};
+
+#pragma omp for schedule(static)
+    for (std::size_t gi = 0; gi < n; ++gi) {
+      auto ii = gi % BLOCK;
+      auto [lo, hi] = overlap({beg, end}, {ii * BLOCK, (ii + 1) * BLOCK});
+      if (hi <= lo)
+        continue;
+
+      dist.fillRow(seed, static_cast<std::uint32_t>(gi), row.data(), n, buf);
+      for (std::size_t bj = 0; bj < side; ++bj) {
+        auto dst = res.data() + blockIdx(gi / BLOCK, bj) * len - beg;
+        for (auto e = lo; e < hi; ++e) {
+          auto gj = bj * BLOCK + e % BLOCK;
+          dst[e] = gj < n ? row[gj] : 0;
+        }
+      }
+    }
+  }
+
+  return res;
+}
+
+// Whole blocks of one rank as a plain matrix and back
+Mat toMat(const Buf &buf, std::size_t nblk) {
+  auto side = blockSide(nblk);
+  Mat res{side * BLOCK, side * BLOCK};
+
+  for (std::size_t z = 0; z < nblk; ++z) {
+    auto [bi, bj] = blockPos(z);
+    for (std::size_t i = 0; i < BLOCK; ++i)
+      std::copy_n(buf.data() + (z * BLOCK + i) * BLOCK, BLOCK,
+                  res[bi * BLOCK + i] + bj * BLOCK);
+  }
+  return res;
+}
+
+Buf fromMat(const Mat &mat, std::size_t nblk) {
+  Buf res(nblk * BLOCK * BLOCK);
+
+  for (std::size_t z = 0; z < nblk; ++z) {
+    auto [bi, bj] = blockPos(z);
+    for (std::size_t i = 0; i < BLOCK; ++i)
+      std::copy_n(mat[bi * BLOCK + i] + bj * BLOCK, BLOCK,
+                  res.data() + (z * BLOCK + i) * BLOCK);
+  }
+  return res;
+}
+
+// first + sign * second of the quarters 0..3 (11, 12, 21, 22), sign 0
+// takes first alone
+struct Comb {
+  int first, sign, second;
+};
+
+// Operands of Strassen product id (M1..M7 as in mul::mulStrassen)
+constexpr std::array<std::array<Comb, 2>, NSUB> OPERANDS{{
+    {{{0, 1, 3}, {0, 1, 3}}},
+    {{{2, 1, 3}, {0, 0, 0}}},
+    {{{0, 0, 0}, {1, -1, 3}}},
+    {{{3, 0, 0}, {2, -1, 0}}},
+    {{{0, 1, 1}, {3, 0, 0}}},
+    {{{2, -1, 0}, {0, 1, 1}}},
+    {{{1, -1, 3}, {2, 1, 3}}},
+}};
+
+// Sign of product id in the quarters 11, 12, 21, 22 of the result
+constexpr std::array<std::array<int, 4>, NSUB> RESULT{{
+    {1, 0, 0, 1},
+    {0, 0, 1, -1},
+    {0, 1, 0, 1},
+    {1, 0, 1, 0},
+    {-1, 1, 0, 0},
+    {0, 0, 0, 1},
+    {1, 0, 0, 0},
+}};
+
+Buf combine(const Buf &buf, Comb cmb, std::size_t qlen) {
+  Buf res(qlen);
+  auto first = buf.data() + cmb.first * qlen,
+       second = buf.data() + cmb.second * qlen;
+
+#pragma omp parallel for schedule(static)
+  for (std::size_t i = 0; i < qlen; ++i)
+    res[i] = first[i] + cmb.sign * second[i];
+
+  return res;
+}
+
+// c += product id in its quarters
+void accumulate(Buf &c, const Buf &prod, int id, std::size_t qlen) {
+  for (std::size_t q = 0; q < 4; ++q) {
+    auto sign = RESULT[id][q];
+    if (sign == 0)
+      continue;
+
+    auto dst = c.data() + q * qlen;
+#pragma omp parallel for schedule(static)
+    for (std::size_t i = 0; i < qlen; ++i)
+      dst[i] += sign * prod[i];
+  }
+}
+
+// Leaf block on several ranks: operands are gathered, every rank computes
+// the rows covering its part of the result
+Buf mulLeafRows(const Buf &a, const Buf &b, MPI::Intracomm &comm) {
+  auto rank = comm.Get_rank();
+  auto commsize = comm.Get_size();
+
+  std::vector<int> counts(commsize), displs(commsize);
+  for (int r = 0; r < commsize; ++r) {
+    auto [beg, end] = chunkOf(r, commsize);
+    displs[r] = beg, counts[r] = end - beg;
+  }
+
+  Buf full_a(BLOCK * BLOCK), full_b(BLOCK * BLOCK);
+  comm.Allgatherv(a.data(), a.size(), MPI::INT, full_a.data(), counts.data(),
+                  displs.data(), MPI::INT);
+  comm.Allgatherv(b.data(), b.size(), MPI::INT, full_b.data(), counts.data(),
+                  displs.data(), MPI::INT);
+
+  auto [beg, end] = chunkOf(rank, commsize);
+  if (end == beg)
+    return {};
+
+  auto row_beg = beg / BLOCK, row_end = (end - 1) / BLOCK + 1;
+  Mat lhs{row_end - row_beg, BLOCK, full_a.begin() + row_beg * BLOCK,
+          full_a.begin() + row_end * BLOCK};
+  auto prod =
+      mul::mulOmpProm8xTranspIntr(lhs, Mat{BLOCK, BLOCK, full_b.begin(),
+                                           full_b.end()});
+
+  Buf res(end - beg);
+  for (auto e = beg; e < end; ++e)
+    res[e - beg] = prod[e / BLOCK - row_beg][e % BLOCK];
+  return res;
+}
+
+Buf caps(const Buf &a, const Buf &b, std::size_t nblk, MPI::Intracomm &comm,
+         const Config &cfg);
+
+// BFS step: rank r computes all seven operand pairs of its part, group g
+// of ranks [lead(g), lead(g + 1)) receives pair g in its own layout,
+// multiplies it and sends every rank its part of product g back
+Buf capsBfs(const Buf &a, const Buf &b, std::size_t nblk,
+            MPI::Intracomm &comm, const Config &cfg) {
+  auto rank = comm.Get_rank();
+  auto commsize = comm.Get_size();
+  auto lead = [commsize](int grp) {
+    return (grp * commsize + NSUB - 1) / NSUB;
+  };
+  auto groupOf = [commsize](int r) { return r * NSUB / commsize; };
+
+  auto mine = chunkOf(rank, commsize);
+  auto len = mine.second - mine.first, q = nblk / 4, qlen = q * len;
+  int grp = groupOf(rank), grp_rank = rank - lead(grp),
+      grp_size = lead(grp + 1) - lead(grp);
+  auto grp_mine = chunkOf(grp_rank, grp_size);
+  auto grp_len = grp_mine.second - grp_mine.first;
+
+  // Part of every block moving between rank r of comm and rank d, the
+  // latter in the layout of its group
+  auto part = [&](int r, int d) {
+    auto g = groupOf(d);
+    return overlap(chunkOf(r, commsize),
+                   chunkOf(d - lead(g), lead(g + 1) - lead(g)));
+  };
+  auto partLen = [&](int r, int d) {
+    auto [lo, hi] = part(r, d);
+    return hi > lo ? hi - lo : 0;
+  };
+
+  std::vector<int> scounts(commsize), sdispls(commsize), rcounts(commsize),
+      rdispls(commsize);
+  auto setCounts = [&](std::size_t sper, std::size_t rper, auto slen,
+                       auto rlen) {
+    for (int r = 0, sdisp = 0, rdisp = 0; r < commsize; ++r) {
+      scounts[r] = sper * slen(r), sdispls[r] = sdisp;
+      rcounts[r] = rper * rlen(r), rdispls[r] = rdisp;
+      sdisp += scounts[r], rdisp += rcounts[r];
+    }
+  };
+
+  Buf sub_a(q * grp_len), sub_b(q * grp_len);
+  {
+    std::array<std::pair<Buf, Buf>, NSUB> pairs{};
+    for (int g = 0; g < NSUB; ++g)
+      pairs[g] = {combine(a, OPERANDS[g][0], qlen),
+                  combine(b, OPERANDS[g][1], qlen)};
+
+    setCounts(
+        2 * q, 2 * q, [&](int d) { return partLen(rank, d); },
+        [&](int s) { return partLen(s, rank); });
+    Buf sbuf(sdispls.back() + scounts.back()),
+        rbuf(rdispls.back() + rcounts.back());
+
+    for (int d = 0; d < commsize; ++d) {
+      auto [lo, hi] = part(rank, d);
+      if (hi <= lo)
+        continue;
+      auto &&[op_a, op_b] = pairs[groupOf(d)];
+      auto dst = sbuf.begin() + sdispls[d];
+      for (auto *op : {&op_a, &op_b})
+        for (std::size_t blk = 0; blk < q; ++blk)
+          dst = std::copy(op->begin() + blk * len + lo - mine.first,
+                          op->begin() + blk * len + hi - mine.first, dst);
+    }
+
+    comm.Alltoallv(sbuf.data(), scounts.data(), sdispls.data(), MPI::INT,
+                   rbuf.data(), rcounts.data(), rdispls.data(), MPI::INT);
+
+    for (int s = 0; s < commsize; ++s) {
+      auto [lo, hi] = part(s, rank);
+      if (hi <= lo)
+        continue;
+      auto src = rbuf.begin() + rdispls[s];
+      for (auto *op : {&sub_a, &sub_b})
+        for (std::size_t blk = 0; blk < q; ++blk, src += hi - lo)
+          std::copy(src, src + (hi - lo),
+                    op->begin() + blk * grp_len + lo - grp_mine.first);
+    }
+  }
+
+  auto sub = comm.Split(grp, rank);
+  auto prod = caps(sub_a, sub_b, q, sub, cfg);
+  sub.Free();
+  Buf().swap(sub_a), Buf().swap(sub_b);
+
+  setCounts(
+      q, q, [&](int r) { return partLen(r, rank); },
+      [&](int d) { return partLen(rank, d); });
+  Buf sbuf(sdispls.back() + scounts.back()),
+      rbuf(rdispls.back() + rcounts.back());
+
+  for (int r = 0; r < commsize; ++r) {
+    auto [lo, hi] = part(r, rank);
+    if (hi <= lo)
+      continue;
+    auto dst = sbuf.begin() + sdispls[r];
+    for (std::size_t blk = 0; blk < q; ++blk)
+      dst = std::copy(prod.begin() + blk * grp_len + lo - grp_mine.first,
+                      prod.begin() + blk * grp_len + hi - grp_mine.first, dst);
+  }
+  Buf().swap(prod);
+
+  comm.Alltoallv(sbuf.data(), scounts.data(), sdispls.data(), MPI::INT,
+                 rbuf.data(), rcounts.data(), rdispls.data(), MPI::INT);
+
+  std::array<Buf, NSUB> prods{};
+  prods.fill(Buf(qlen));
+  for (int d = 0; d < commsize; ++d) {
+    auto [lo, hi] = part(rank, d);
+    if (hi <= lo)
+      continue;
+    auto src = rbuf.begin() + rdispls[d];
+    for (std::size_t blk = 0; blk < q; ++blk, src += hi - lo)
+      std::copy(src, src + (hi - lo),
+                prods[groupOf(d)].begin() + blk * len + lo - mine.first);
+  }
+
+  Buf c(nblk * len);
+  for (int g = 0; g < NSUB; ++g)
+    accumulate(c, prods[g], g, qlen);
+  return c;
+}
+
+// Rank's part of a * b, both given as parts of nblk blocks
+Buf caps(const Buf &a, const Buf &b, std::size_t nblk, MPI::Intracomm &comm,
+         const Config &cfg) {
+  auto rank = comm.Get_rank();
+  auto commsize = comm.Get_size();
+
+  if (commsize == 1)
+    return fromMat(mul::mulStrassenIntrinsicsOMP(toMat(a, nblk),
+                                                 toMat(b, nblk)),
+                   nblk);
+  if (nblk == 1)
+    return mulLeafRows(a, b, comm);
+
+  auto len = chunkLen(rank, commsize), qlen = nblk / 4 * len;
+  auto grp_len = BLOCK * BLOCK / (commsize / NSUB) + 1;
+
+  // operands and result; seven operand pairs and products, one pair and
+  // product of the group
+  auto bfs_mem = 3 * nblk * len + 3 * NSUB * qlen + 3 * nblk / 4 * grp_len;
+  if (commsize >= NSUB && bfs_mem <= cfg.mem_limit)
+    return capsBfs(a, b, nblk, comm, cfg);
+
+  // DFS step: whole communicator works on every product in turn
+  Buf c(nblk * len);
+  for (int g = 0; g < NSUB; ++g) {
+    auto prod = caps(combine(a, OPERANDS[g][0], qlen),
+                     combine(b, OPERANDS[g][1], qlen), nblk / 4, comm, cfg);
+    accumulate(c, prod, g, qlen);
+  }
+  return c;
+}
+
+// The n x n result on rank 0, for checking
+Mat gatherResult(const Buf &c, std::size_t n, std::size_t nblk,
+                 MPI::Intracomm &comm) {
+  auto rank = comm.Get_rank();
+  auto commsize = comm.Get_size();
+
+  std::vector<int> counts(commsize), displs(commsize);
+  for (int r = 0, disp = 0; r < commsize; ++r) {
+    counts[r] = nblk * chunkLen(r, commsize), displs[r] = disp;
+    disp += counts[r];
+  }
+
+  Buf all(rank == 0 ? nblk * BLOCK * BLOCK : 0);
+  comm.Gatherv(c.data(), c.size(), MPI::INT, all.data(), counts.data(),
+               displs.data(), MPI::INT, 0);
+  if (rank != 0)
+    return Mat{};
+
+  Mat res{n, n};
+  for (int r = 0; r < commsize; ++r) {
+    auto [beg, end] = chunkOf(r, commsize);
+    auto src = all.data() + displs[r];
+    for (std::size_t z = 0; z < nblk; ++z) {
+      auto [bi, bj] = blockPos(z);
+      for (auto e = beg; e < end; ++e, ++src) {
+        auto i = bi * BLOCK + e / BLOCK, j = bj * BLOCK + e % BLOCK;
+        if (i < n && j < n)
+          res[i][j] = *src;
+      }
+    }
+  }
+  return res;
+}
+
+int main(int ac, char **av) {
+  MPI::Init_thread(ac, av, MPI::THREAD_FUNNELED);
+  auto rank = MPI::COMM_WORLD.Get_rank();
+
+  if (ac < 2) {
+    if (rank == 0)
+      std::cout << "Usage: " << av[0] << " N [MEM_LIMIT] [LEAF] [CHECK]"
+                << std::endl;
+    MPI::Finalize();
+    return 0;
+  }
+
+  std::size_t size = std::atoll(av[1]);
+  Config cfg{};
+  if (ac > 2 && std::atoll(av[2]) > 0)
+    cfg.mem_limit = std::atoll(av[2]);
+  if (ac > 3 && std::atoll(av[3]) > 0)
+    cfg.leaf = std::atoll(av[3]);
+  // CHECK gathers the result and regenerates the operands on rank 0, so
+  // it is meant for sizes that fit one node
+  bool check = ac > 4 && std::atoi(av[4]) != 0;
+
+  // Leaf blocks of side at most cfg.leaf, 4^levels of them
+  BLOCK = std::max<std::size_t>(size, 1);
+  std::size_t nblk = 1;
+  while (BLOCK > cfg.leaf)
+    BLOCK = (BLOCK + 1) / 2, nblk *= 4;
+
+  auto world = MPI::COMM_WORLD.Dup();
+  auto lhs = generate(size, nblk, 1, world);
+  auto rhs = generate(size, nblk, 2, world);
+
+  world.Barrier();
+  auto tic = MPI::Wtime();
+  auto res = caps(lhs, rhs, nblk, world, cfg);
+  world.Barrier();
+  auto toc = MPI::Wtime();
+
+  if (rank == 0)
+    std::cout << "Ranks " << world.Get_size() << ", N " << size
+              << ", elapsed time " << (toc - tic) * 1000 << " ms, "
+              << lhs.size() << " elements of each matrix per rank"
+              << std::endl;
+
+  if (check) {
+    auto full = gatherResult(res, size, nblk, world);
+    if (rank == 0) {
+      rnd::Uniform<std::int32_t> dist{-10, 10};
+      bool ok = full == mul::mulOmpProm8xTranspIntr(
+                            rnd::randMatrix<std::int32_t>(size, size, 1, dist),
+                            rnd::randMatrix<std::int32_t>(size, size, 2, dist));
+      std::cout << "Check " << (ok ? "passed" : "FAILED") << std::endl;
+    }
+  }
+
+  world.Free();
+  MPI::Finalize();
+  return 0;
+}
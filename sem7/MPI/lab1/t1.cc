@@ -1,69 +1,101 @@
 #include <algorithm>
 #include <array>
 #include <cmath>
-#include <fstream>
 #include <functional>
 #include <iostream>
+#include <stdexcept>
 #include <string>
+#include <string_view>
+#include <utility>
 #include <vector>
 
 #include <mpi/mpi.h>
+#include <omp.h>
 
-constexpr std::size_t ISIZE = 5000;
-constexpr std::size_t JSIZE = 5000;
+#include "array2d.hh"
+#include "array2d_mpi.hh"
+#include "bench.hh"
+#include "bench_mpi.hh"
+#include "dump_mpi.hh"
+#include "vsin.hh"
 
-constexpr auto ISIZE_USED = ISIZE - 8;
-constexpr auto JSIZE_USED = JSIZE - 3;
+// Array size, "size=IxJ" on the command line
+std::size_t ISIZE = 5000;
+std::size_t JSIZE = 5000;
 
-using ArrTy = std::vector<std::vector<double>>;
-using Dumper = std::function<void(const ArrTy &, std::ostream &)>;
+using ArrTy = lab::Array2D<double>;
+using Format = lab::DumpWriter::Format;
 
-void printArr(const ArrTy &arr, std::ostream &ost) {
-  for (auto &&row : arr) {
-    for (auto elem : row)
-      ost << elem << " ";
-    ost << std::endl;
-  }
+// Row sine kernel, see vsin.hh; the same one is used by all versions so
+// that their results stay comparable
+lab::RowSin rowSin = lab::sinRowLibm;
+
+// MPI provides THREAD_MULTIPLE, so communication may run in an OpenMP task
+// on any thread; otherwise such tasks are undeferred and run by the master
+bool commTasks = false;
+
+// name.bin or name.txt
+std::string dumpName(std::string_view name, Format fmt) {
+  return std::string{name} + (fmt == Format::Binary ? ".bin" : ".txt");
 }
 
-using ProcFunc = std::function<void(ArrTy &)>;
+// Part of the global array held by a rank: arr[i][j] is element
+// (i0 + i, j0 + j)
+struct Local {
+  ArrTy arr{};
+  std::size_t i0 = 0, j0 = 0;
+};
 
-void ethalon(ArrTy &arr) {
-  auto rank = MPI::COMM_WORLD.Get_rank();
+// Fills the part of the array a version works on
+using InitFunc = std::function<void(Local &)>;
+// Processing returns the global block of this rank's results and marks its
+// communication in the timer
+using ProcFunc = std::function<lab::Block(Local &, lab::PhaseTimer &)>;
+
+// Element (i, j) of the input
+double initVal(std::size_t i, std::size_t j) { return 10 * i + j; }
+
+void initArr(Local &loc) {
+  // Fill array with data
+  loc = {ArrTy{ISIZE, JSIZE, initVal}};
+}
+
+// Rows [ibeg, iend) of rank r for the ethalon
+std::pair<std::size_t, std::size_t> rowsOf(int r) {
   auto commsize = MPI::COMM_WORLD.Get_size();
+  return {ISIZE * r / commsize, ISIZE * (r + 1) / commsize};
+}
 
-  for (std::size_t i = rank; i < ISIZE; i += commsize)
-    for (std::size_t j = 0; j < JSIZE; ++j)
-      arr[i][j] = std::sin(4 * arr[i][j]);
-
-  for (std::size_t i = rank; i < ISIZE; i += commsize) {
-    if (rank != 0) {
-      MPI::COMM_WORLD.Send(arr[i].data(), ISIZE, MPI::DOUBLE, 0,
-                           static_cast<int>(i));
-    } else {
-      for (std::size_t id = 1; static_cast<int>(id) < commsize; ++id)
-        if (i + id < ISIZE)
-          MPI::COMM_WORLD.Recv(arr[i + id].data(), ISIZE, MPI::DOUBLE, id,
-                               static_cast<int>(i + id));
-    }
-  }
+void initRows(Local &loc) {
+  auto [ibeg, iend] = rowsOf(MPI::COMM_WORLD.Get_rank());
+  loc = {ArrTy{iend - ibeg, JSIZE,
+               [ibeg](auto i, auto j) { return initVal(ibeg + i, j); }},
+         ibeg};
+}
+
+lab::Block ethalon(Local &loc, lab::PhaseTimer &) {
+  auto &&arr = loc.arr;
+
+#pragma omp parallel for schedule(static)
+  for (std::size_t i = 0; i < arr.getRows(); ++i)
+    rowSin(arr[i], arr[i], JSIZE, 4);
+
+  return {loc.i0, 0, arr.getRows(), JSIZE};
 }
 
-void processArr(ArrTy &arr) {
+lab::Block processArr(Local &loc, lab::PhaseTimer &) {
+  auto &&arr = loc.arr;
   // Original cycle
   // for (std::size_t i = 8; i < ISIZE; i++)
   //   for (std::size_t j = 0; j < JSIZE - 3; j++)
   //     arr[i][j] = std::sin(4 * arr[i - 8][j - 3]);
-  // Normalized version
-  for (std::size_t i = 0; i < ISIZE_USED; i++)
-    for (std::size_t j = 0; j < JSIZE_USED; j++) {
-      arr[i + 8][j] = std::sin(4 * arr[i][j + 3]);
-      // if (i == ISIZE_USED - 1) {
-      //   std::cout << "arr[" << (i + 8) << "][" << j << "] = " << arr[i + 8][j] << std::endl;
-      //   std::cout << "arr[" << i << "][" << (j + 3) << "] = " << arr[i][j + 3] << std::endl;
-      //   std::cout << std::endl;
-      // }
-    }
+  // Normalized version, the inner loop
+  //   arr[i + 8][j] = std::sin(4 * arr[i][j + 3]), j < JSIZE_USED
+  // is one row kernel call
+  for (std::size_t i = 0; i < ISIZE - 8; i++)
+    rowSin(arr[i + 8], arr[i] + 3, JSIZE - 3, 4);
+
+  return {0, 0, ISIZE, JSIZE};
 }
 // Check bernstein condition:
 // F(k1, k2) = (k1 + 8, k2)
@@ -76,123 +108,279 @@ void processArr(ArrTy &arr) {
 // > ==> i true-dependency
 // < ==> j false-dependency
 
-void processArrPar(ArrTy &arrT) {
+// Parallel version: columns are block-distributed, i is pipelined.
+// Row i + 8 of a column block needs row i of the next 3 columns, i.e. the
+// first 3 columns of the right neighbour. Rows are processed in tiles of
+// ITILE; after a tile a rank passes its first 3 columns of that tile to
+// the left neighbour with non-blocking send, so the ranks form a
+// right-to-left pipeline lagging one tile behind each other.
+// Inside a rank the tile is computed by OpenMP tasks: rows of a batch of 8
+// read only rows of earlier batches, so a batch is split into pieces of
+// JCHUNK columns of its rows. Batch q of a tile reaches the halo through
+// the last 3 * (q + 1) columns only, so the interior left of this
+// staircase is computed while a communication task waits for the halo,
+// and the narrow edge is finished after it.
+constexpr std::size_t IDIST = 8;
+constexpr std::size_t JDIST = 3;
+constexpr std::size_t ITILE = 64;
+constexpr std::size_t JCHUNK = 512;
+
+// Columns [jbeg, jend) of rank r
+std::pair<std::size_t, std::size_t> colsOf(int r) {
+  auto commsize = MPI::COMM_WORLD.Get_size();
+  return {JSIZE * r / commsize, JSIZE * (r + 1) / commsize};
+}
+
+// A rank holds only its columns and the right halo, ISIZE x (ncols + 3);
+// halo columns past the array are zero
+void initCols(Local &loc) {
+  auto [jbeg, jend] = colsOf(MPI::COMM_WORLD.Get_rank());
+  loc = {ArrTy{ISIZE, jend - jbeg + JDIST,
+               [jbeg](auto i, auto j) {
+                 return jbeg + j < JSIZE ? initVal(i, jbeg + j) : 0;
+               }},
+         0, jbeg};
+}
+
+lab::Block processArrPar(Local &part, lab::PhaseTimer &timer, bool gather) {
   auto rank = MPI::COMM_WORLD.Get_rank();
   auto commsize = MPI::COMM_WORLD.Get_size();
 
-  for (std::size_t i = 0; i < ISIZE_USED; i++) {
-    MPI::COMM_WORLD.Barrier();
-    for (std::size_t j = rank; j < JSIZE_USED; j += commsize) {
-      arrT[j][i + 8] = std::sin(4 * arrT[j + 3][i]);
-      // if (i == ISIZE_USED - 1) {
-      //   std::cout << "arrT[" << j << "][" << (i + 8) << "] = " << arrT[j][i + 8] << std::endl;
-      //   std::cout << "arrT[" << (j + 3) << "][" << i << "] = " << arrT[j + 3][i] << std::endl;
-      //   std::cout << std::endl;
-      // }
+  auto [jbeg, jend] = colsOf(rank);
+  auto ncols = jend - jbeg;
+  auto &&loc = part.arr;
+  auto width = loc.getCols();
+  auto jused = JSIZE - JDIST;
+  auto jcalc = jbeg < jused ? std::min(jend, jused) - jbeg : 0;
+
+  bool has_left = rank > 0, has_right = rank + 1 < commsize;
+  auto ntiles = (ISIZE - IDIST + ITILE - 1) / ITILE;
+  auto tileBeg = [](std::size_t t) { return IDIST + t * ITILE; };
+  auto tileEnd = [](std::size_t t) {
+    return std::min(IDIST + (t + 1) * ITILE, ISIZE);
+  };
+
+  // Halo tiles are received right into loc, sent columns are never
+  // written again, so no buffers are needed
+  std::array<MPI::Request, 2> rreq;
+  std::vector<MPI::Request> sreq{};
+
+  auto postRecv = [&](std::size_t t) {
+    auto ibeg = tileBeg(t);
+    auto type = lab::subarrayType(loc, ibeg, ncols, tileEnd(t) - ibeg, JDIST);
+    rreq[t % 2] = MPI::COMM_WORLD.Irecv(loc.data(), 1, type, rank + 1,
+                                        static_cast<int>(t));
+  };
+
+  // Columns of batch q depending on the halo; a rank with a right
+  // neighbour has jcalc == ncols
+  auto edgeCols = [&](std::size_t q) {
+    return has_right ? std::min(jcalc, JDIST * (q + 1)) : 0;
+  };
+
+  if (has_right)
+    postRecv(0);
+
+#pragma omp parallel
+#pragma omp master
+  for (std::size_t t = 0; t < ntiles; ++t) {
+    auto ibeg = tileBeg(t), iend = tileEnd(t);
+
+    if (has_right) {
+#pragma omp task if (commTasks)
+      {
+        if (t + 1 < ntiles)
+          postRecv(t + 1);
+        rreq[t % 2].Wait();
+      }
     }
-  }
 
-  for (std::size_t i = rank; i < ISIZE; i += commsize) {
-    if (rank != 0) {
-      MPI::COMM_WORLD.Send(arrT[i].data(), ISIZE, MPI::DOUBLE, 0,
-                           static_cast<int>(i));
-    } else {
-      for (std::size_t id = 1; static_cast<int>(id) < commsize; ++id)
-        if (i + id < ISIZE)
-          MPI::COMM_WORLD.Recv(arrT[i + id].data(), ISIZE, MPI::DOUBLE, id,
-                               static_cast<int>(i + id));
+    for (std::size_t bbeg = ibeg, q = 0; bbeg < iend; bbeg += IDIST, ++q) {
+      auto bend = std::min(bbeg + IDIST, iend);
+      auto jint = jcalc - edgeCols(q);
+#pragma omp taskloop collapse(2)
+      for (auto i = bbeg; i < bend; ++i)
+        for (std::size_t jb = 0; jb < jint; jb += JCHUNK)
+          rowSin(loc[i] + jb, loc[i - IDIST] + JDIST + jb,
+                 std::min(JCHUNK, jint - jb), 4);
     }
-  }
-}
 
-void measureDump(ProcFunc f, ArrTy &arr, std::string_view filename,
-                 Dumper dumper) {
-  auto rank = MPI::COMM_WORLD.Get_rank();
-  MPI::COMM_WORLD.Barrier();
-  auto tic = MPI::Wtime();
-  f(arr);
-  MPI::COMM_WORLD.Barrier();
-  auto toc = MPI::Wtime();
-
-  if (rank != 0) {
-    arr.clear();
-    return;
-  }
+    // Only the part of the halo wait not hidden by the interior is counted
+    timer.time(lab::Phase::Comm, [] {
+#pragma omp taskwait
+    });
 
-  std::cout << "Elapsed time " << (toc - tic) * 1000 << " ms" << std::endl;
+    for (std::size_t bbeg = ibeg, q = 0; bbeg < iend; bbeg += IDIST, ++q) {
+      auto jint = jcalc - edgeCols(q);
+      for (auto i = bbeg; i < std::min(bbeg + IDIST, iend); ++i)
+        rowSin(loc[i] + jint, loc[i - IDIST] + JDIST + jint, jcalc - jint, 4);
+    }
 
-  std::ofstream of(filename.data());
-  if (!of) {
-    std::cerr << "Cannot open file for results" << std::endl;
-    return;
+    if (has_left) {
+      auto type = lab::subarrayType(loc, ibeg, 0, iend - ibeg, JDIST);
+      sreq.push_back(MPI::COMM_WORLD.Isend(loc.data(), 1, type, rank - 1,
+                                           static_cast<int>(t)));
+    }
   }
-  dumper(arr, of);
-}
 
-void initArr(ArrTy &a) {
-  a.resize(ISIZE);
-  // Fill array with data
-  for (std::size_t i = 0; i < a.size(); i++) {
-    auto &ai = a[i];
-    ai.resize(JSIZE);
-    for (std::size_t j = 0; j < ai.size(); j++)
-      ai[j] = 10 * i + j;
-  }
-}
+  timer.time(lab::Phase::Comm,
+             [&] { MPI::Request::Waitall(sreq.size(), sreq.data()); });
 
-void initTArr(ArrTy &a) {
-  a.resize(JSIZE);
-  // Fill array with data
-  for (std::size_t j = 0; j < a.size(); j++) {
-    auto &aj = a[j];
-    aj.resize(ISIZE);
-    for (std::size_t i = 0; i < aj.size(); i++)
-      aj[i] = 10 * i + j;
-  }
-}
+  // Results stay distributed and are written by every rank
+  if (!gather)
+    return {0, jbeg, ISIZE, ncols};
 
-void printTArr(const ArrTy &a, std::ostream &ost) {
-  for (std::size_t i = 0; i < a.size(); ++i) {
-    for (std::size_t j = 0; j < a[i].size(); ++j)
-      ost << a[j][i] << " ";
-    ost << std::endl;
+  // Collect column blocks column by column into the only full array, the
+  // one on rank 0
+  std::vector<int> counts(commsize), displs(commsize);
+  for (int r = 0; r < commsize; ++r) {
+    auto [rbeg, rend] = colsOf(r);
+    displs[r] = rbeg, counts[r] = rend - rbeg;
   }
-}
 
-void doSeq() {
-  ArrTy a{};
-  initArr(a);
+  ArrTy res{};
+  if (rank == 0)
+    res = ArrTy{ISIZE, JSIZE};
+  auto send_type = lab::columnsType<double>(ISIZE, width);
+  auto recv_type = lab::columnsType<double>(ISIZE, JSIZE);
+  timer.time(lab::Phase::Comm, [&] {
+    MPI::COMM_WORLD.Gatherv(loc.data(), ncols, send_type, res.data(),
+                            counts.data(), displs.data(), recv_type, 0);
+  });
 
-  std::cout << "Sequential:" << std::endl;
-  measureDump(processArr, a, "seq.txt", printArr);
+  if (rank != 0)
+    return {};
+  part = {std::move(res)};
+  return {0, 0, ISIZE, JSIZE};
 }
 
-void doPar() {
-  ArrTy aT{};
-  initTArr(aT);
+// Runs f on a fresh array and writes its results, as many times as cfg
+// says; returns this rank's timings
+lab::BenchRecord measureDump(InitFunc init, ProcFunc f, std::string_view name,
+                             Format fmt, const lab::BenchConfig &cfg) {
+  Local loc{};
+  lab::Block blk{};
+  lab::BenchCase bc{[&] { init(loc); },
+                    [&](lab::PhaseTimer &timer) { blk = f(loc, timer); },
+                    [&] {
+                      lab::DumpWriter out{MPI::COMM_WORLD,
+                                          dumpName(name, fmt), fmt};
+                      auto part = blk.empty()
+                                      ? lab::Block{}
+                                      : lab::Block{blk.i0 - loc.i0,
+                                                   blk.j0 - loc.j0, blk.rows,
+                                                   blk.cols};
+                      out.write(ISIZE, JSIZE, blk,
+                                std::as_const(loc.arr).block(part));
+                    }};
 
-  if (MPI::COMM_WORLD.Get_rank() == 0)
-    std::cout << "Parallel:" << std::endl;
-  measureDump(processArrPar, aT, "par.txt", printTArr);
+  return {std::string{name},
+          MPI::COMM_WORLD.Get_rank(),
+          MPI::COMM_WORLD.Get_size(),
+          omp_get_max_threads(),
+          ISIZE,
+          JSIZE,
+          cfg.repeats,
+          lab::runBench(bc, cfg)};
 }
 
-void doEth() {
-  ArrTy a{};
-  initArr(a);
-
-  if (MPI::COMM_WORLD.Get_rank() == 0)
-    std::cout << "Ethalon:" << std::endl;
-  measureDump(ethalon, a, "eth.txt", printArr);
+void printTimes(const lab::BenchRecord &rec) {
+  auto &&stats = rec.stats;
+  auto ms = [&stats](lab::Phase phase) {
+    return stats[static_cast<std::size_t>(phase)].median * 1000;
+  };
+  std::cout << "Elapsed time " << ms(lab::Phase::Compute) + ms(lab::Phase::Comm)
+            << " ms" << std::endl;
+  std::cout << "Dump time " << ms(lab::Phase::Output) << " ms" << std::endl;
 }
 
 int main(int argc, char *argv[]) {
-  MPI::Init(argc, argv);
+  // Hybrid run: OMP_NUM_THREADS threads per rank, communication tasks need
+  // MPI from any thread
+  commTasks = MPI::Init_thread(argc, argv, MPI::THREAD_MULTIPLE) ==
+              MPI::THREAD_MULTIPLE;
+  auto rank = MPI::COMM_WORLD.Get_rank();
   auto commsz = MPI::COMM_WORLD.Get_size();
+  // "gather": collect parallel results on rank 0 before writing them
+  // "text": write text dumps instead of binary ones
+  // "sin=libm|ulp1|fast": row sine kernel
+  // "size=IxJ", "bench=N", "warmup=N", "report=csv|json": see bench.hh
+  bool gather = false;
+  auto fmt = Format::Binary;
+  lab::BenchArgs args{};
+  try {
+    for (int i = 1; i < argc; ++i) {
+      std::string_view arg{argv[i]};
+      gather = gather || arg == "gather";
+      if (arg == "text")
+        fmt = Format::Text;
+      if (arg.starts_with("sin="))
+        rowSin = lab::rowSinByName(arg.substr(4));
+      lab::parseBenchArg(arg, args);
+    }
+  } catch (const std::invalid_argument &err) {
+    if (rank == 0)
+      std::cerr << err.what() << std::endl;
+    MPI::Finalize();
+    return 1;
+  }
+
+  if (rowSin == nullptr) {
+    if (rank == 0)
+      std::cerr << "Unknown sine kernel" << std::endl;
+    MPI::Finalize();
+    return 1;
+  }
+
+  if (args.rows != 0)
+    ISIZE = args.rows, JSIZE = args.cols;
+  if (ISIZE <= IDIST || JSIZE <= JDIST) {
+    if (rank == 0)
+      std::cerr << "Array must be larger than 8x3" << std::endl;
+    MPI::Finalize();
+    return 1;
+  }
 
+  if (JSIZE / commsz < JDIST) {
+    if (rank == 0)
+      std::cerr << "Too many processes for column blocks" << std::endl;
+    MPI::Finalize();
+    return 1;
+  }
+
+  // Without "bench" every version runs once and prints its times
+  auto cfg = args.bench ? args.cfg : lab::BenchConfig{0, 1};
+  cfg.sync = [] { MPI::COMM_WORLD.Barrier(); };
+
+  struct Case {
+    std::string_view name, title;
+    InitFunc init;
+    ProcFunc func;
+  };
+  std::vector<Case> cases{};
   if (commsz == 1)
-    doSeq();
+    cases.push_back({"seq", "Sequential:", initArr, processArr});
+  cases.push_back({"par", "Parallel:", initCols,
+                   [gather](Local &loc, lab::PhaseTimer &timer) {
+                     return processArrPar(loc, timer, gather);
+                   }});
+  cases.push_back({"eth", "Ethalon:", initRows, ethalon});
+
+  std::vector<lab::BenchRecord> records{};
+  for (auto &&[name, title, init, func] : cases) {
+    if (!args.bench && rank == 0)
+      std::cout << title << std::endl;
+
+    auto rec = measureDump(init, func, name, fmt, cfg);
+    if (!args.bench && rank == 0)
+      printTimes(rec);
+
+    auto all = lab::gatherRecords(MPI::COMM_WORLD, rec);
+    records.insert(records.end(), all.begin(), all.end());
+  }
 
-  doPar(), doEth();
+  if (args.bench && rank == 0)
+    lab::writeReport(std::cout, records, args.fmt);
 
   MPI::Finalize();
 }
@@ -2,59 +2,95 @@
 #include <array>
 #include <cmath>
 #include <cstddef>
-#include <fstream>
 #include <functional>
 #include <iostream>
+#include <stdexcept>
 #include <string>
+#include <string_view>
+#include <utility>
 #include <vector>
 
 #include <mpi/mpi.h>
+#include <omp.h>
 
-constexpr std::size_t ISIZE = 5000;
-constexpr std::size_t JSIZE = 5000;
+#include "array2d.hh"
+#include "bench.hh"
+#include "bench_mpi.hh"
+#include "dump_mpi.hh"
+#include "vsin.hh"
 
-using ArrTy = std::vector<std::vector<double>>;
-using Dumper = std::function<void(const ArrTy &, std::ostream &)>;
+// Array size, "size=IxJ" on the command line
+std::size_t ISIZE = 5000;
+std::size_t JSIZE = 5000;
 
-void printArr(const ArrTy &arr, std::ostream &ost) {
-  for (auto &&row : arr) {
-    for (auto elem : row)
-      ost << elem << " ";
-    ost << std::endl;
-  }
+using ArrTy = lab::Array2D<double>;
+using Format = lab::DumpWriter::Format;
+
+// Row sine kernel, see vsin.hh; the same one is used by all versions so
+// that their results stay comparable
+lab::RowSin rowSin = lab::sinRowLibm;
+
+// MPI provides THREAD_MULTIPLE, so communication may run in an OpenMP task
+// on any thread; otherwise such tasks are undeferred and run by the master
+bool commTasks = false;
+
+// name.bin or name.txt
+std::string dumpName(std::string_view name, Format fmt) {
+  return std::string{name} + (fmt == Format::Binary ? ".bin" : ".txt");
 }
 
-using ProcFunc = std::function<void(ArrTy &, ArrTy &)>;
+// Rows of a and b held by a rank: a[i][j] and b[i][j] are elements
+// (i0 + i, j), a may hold more rows than b
+struct Local {
+  ArrTy a{}, b{};
+  std::size_t i0 = 0;
+};
 
-void ethalon(ArrTy &a, ArrTy &b) {
-  auto rank = MPI::COMM_WORLD.Get_rank();
+// Fills the parts of the arrays a version works on
+using InitFunc = std::function<void(Local &)>;
+// Processing returns the global block of a and b holding this rank's
+// results and marks its communication in the timer
+using ProcFunc = std::function<lab::Block(Local &, lab::PhaseTimer &)>;
+
+// Element (i, j) of the input
+double initVal(std::size_t i, std::size_t j) { return 10 * i + j; }
+
+// Rows [ibeg, iend) of rank r
+std::pair<std::size_t, std::size_t> rowsOf(int r) {
   auto commsize = MPI::COMM_WORLD.Get_size();
+  return {ISIZE * r / commsize, ISIZE * (r + 1) / commsize};
+}
 
-  for (std::size_t i = rank; i < ISIZE; i += commsize)
-    for (std::size_t j = 0; j < JSIZE; ++j) {
-      a[i][j] = std::sin(4 * a[i][j]);
-      b[i][j] = a[i][j] * 3;
-    }
+// Rows [ibeg, iend + extra) of a and [ibeg, iend) of b, clipped to the array
+void initRows(Local &loc, std::size_t extra) {
+  auto [ibeg, iend] = rowsOf(MPI::COMM_WORLD.Get_rank());
+  auto aend = std::min(iend + extra, ISIZE);
+  loc = {ArrTy{aend - ibeg, JSIZE,
+               [ibeg](auto i, auto j) { return initVal(ibeg + i, j); }},
+         ArrTy{iend - ibeg, JSIZE}, ibeg};
+}
 
-  for (std::size_t i = rank; i < ISIZE; i += commsize) {
-    if (rank != 0) {
-      MPI::COMM_WORLD.Send(a[i].data(), ISIZE, MPI::DOUBLE, 0,
-                           static_cast<int>(i));
-      MPI::COMM_WORLD.Send(b[i].data(), ISIZE, MPI::DOUBLE, 0,
-                           static_cast<int>(i));
-    } else {
-      for (std::size_t id = 1; static_cast<int>(id) < commsize; ++id)
-        if (i + id < ISIZE) {
-          MPI::COMM_WORLD.Recv(a[i + id].data(), ISIZE, MPI::DOUBLE, id,
-                               static_cast<int>(i + id));
-          MPI::COMM_WORLD.Recv(b[i + id].data(), ISIZE, MPI::DOUBLE, id,
-                               static_cast<int>(i + id));
-        }
-    }
+void initArr(Local &loc) {
+  // Fill array with data
+  loc = {ArrTy{ISIZE, JSIZE, initVal}, ArrTy{ISIZE, JSIZE}};
+}
+
+lab::Block ethalon(Local &loc, lab::PhaseTimer &) {
+  auto &&[a, b, i0] = loc;
+
+#pragma omp parallel for schedule(static)
+  for (std::size_t i = 0; i < a.getRows(); ++i) {
+    rowSin(a[i], a[i], JSIZE, 4);
+    for (std::size_t j = 0; j < JSIZE; ++j)
+      b[i][j] = a[i][j] * 3;
   }
+
+  return {i0, 0, a.getRows(), JSIZE};
 }
 
-void processArr(ArrTy &a, ArrTy &b) {
+lab::Block processArr(Local &loc, lab::PhaseTimer &) {
+  auto &&a = loc.a;
+  auto &&b = loc.b;
   // Original cycles
   //
   // for (std::size_t i = 0; i < ISIZE; i++)
@@ -67,163 +103,215 @@ void processArr(ArrTy &a, ArrTy &b) {
 
   // Normalized version
   std::size_t i = 0;
-  for (; i < 3; i++) {
-    for (std::size_t j = 0; j < JSIZE; j++) {
-      a[i][j] = std::sin(0.001 * a[i][j]);
-    }
-  }
+  for (; i < 3; i++)
+    rowSin(a[i], a[i], JSIZE, 0.001);
 
   for (; i < ISIZE; i++) {
-    std::size_t j = 0;
-    for (; j < JSIZE - 5; j++) {
-      a[i][j] = std::sin(0.001 * a[i][j]);
+    rowSin(a[i], a[i], JSIZE, 0.001);
+    for (std::size_t j = 0; j < JSIZE - 5; j++)
       b[i - 3][j + 5] = a[i][j] * 3;
-    }
-
-    for (; j < JSIZE; j++)
-      a[i][j] = std::sin(0.001 * a[i][j]);
   }
+
+  return {0, 0, ISIZE, JSIZE};
 }
 
-void processArrPar(ArrTy &aT, ArrTy &bT) {
+// Parallel version: rows are block-distributed. The a update is pointwise
+// and b row i - 3 reads only a row i, so a rank holding rows [ibeg, iend)
+// of b and [ibeg, iend + 3) of a updates the 3 extra a rows for itself and
+// needs no messages while computing. Rows are independent, so inside a
+// rank they are shared by OpenMP threads.
+// Without gather a and b are produced in one pass over the block. With
+// gather a is finished first and a communication task collects it on
+// rank 0 while the other threads compute b from it; b is collected last.
+constexpr std::size_t IDIST = 3;
+constexpr std::size_t JDIST = 5;
+
+lab::Block processArrPar(Local &part, lab::PhaseTimer &timer, bool gather) {
   auto rank = MPI::COMM_WORLD.Get_rank();
   auto commsize = MPI::COMM_WORLD.Get_size();
 
-  std::size_t i = 0;
-  for (; i < 3; i++) {
-    for (std::size_t j = rank; j < JSIZE; j += commsize) {
-      aT[j][i] = std::sin(0.001 * aT[j][i]);
-    }
-  }
-
-  for (; i < ISIZE; i++) {
-    MPI::COMM_WORLD.Barrier();
-    std::size_t j = rank;
-    for (; j < JSIZE - 5; j += commsize) {
-      aT[j][i] = std::sin(0.001 * aT[j][i]);
-      bT[j + 5][i - 3] = aT[j][i] * 3;
+  auto &&[a, b, i0] = part;
+  auto nrows = b.getRows();
+  // b row i is a row i + 3, the last 3 rows of the array stay zero
+  auto brows = std::max(a.getRows(), IDIST) - IDIST;
+  auto bRow = [&](std::size_t i) {
+    for (std::size_t j = 0; j < JSIZE - JDIST; ++j)
+      b[i][j + JDIST] = a[i + IDIST][j] * 3;
+  };
+
+  if (!gather) {
+#pragma omp parallel for schedule(static)
+    for (std::size_t i = 0; i < a.getRows(); ++i) {
+      rowSin(a[i], a[i], JSIZE, 0.001);
+      if (i >= IDIST)
+        bRow(i - IDIST);
     }
 
-    for (; j < JSIZE; j += commsize)
-      aT[j][i] = std::sin(0.001 * aT[j][i]);
+    return {i0, 0, nrows, JSIZE};
   }
 
-  for (std::size_t j = rank; j < JSIZE; j += commsize) {
-    if (rank != 0) {
-      MPI::COMM_WORLD.Send(aT[j].data(), JSIZE, MPI::DOUBLE, 0,
-                           static_cast<int>(j));
-      if (j + 5 < JSIZE)
-        MPI::COMM_WORLD.Send(bT[j + 5].data(), JSIZE, MPI::DOUBLE, 0,
-                             static_cast<int>(j + 5));
-    } else {
-      for (std::size_t id = 1; static_cast<int>(id) < commsize; ++id)
-        if (j + id < JSIZE) {
-          MPI::COMM_WORLD.Recv(aT[j + id].data(), JSIZE, MPI::DOUBLE, id,
-                               static_cast<int>(j + id));
-          if (j + id + 5 < JSIZE)
-            MPI::COMM_WORLD.Recv(bT[j + id + 5].data(), JSIZE, MPI::DOUBLE, id,
-                                 static_cast<int>(j + id + 5));
-        }
-    }
-  }
-}
+#pragma omp parallel for schedule(static)
+  for (std::size_t i = 0; i < a.getRows(); ++i)
+    rowSin(a[i], a[i], JSIZE, 0.001);
 
-void measureDump(ProcFunc f, ArrTy &a, ArrTy &b, std::string_view filename,
-                 Dumper dumper) {
-  auto rank = MPI::COMM_WORLD.Get_rank();
-  MPI::COMM_WORLD.Barrier();
-  auto tic = MPI::Wtime();
-  f(a, b);
-  MPI::COMM_WORLD.Barrier();
-  auto toc = MPI::Wtime();
-
-  if (rank != 0) {
-    a.clear();
-    return;
+  // Row blocks are contiguous, the full arrays exist on rank 0 only
+  std::vector<int> counts(commsize), displs(commsize);
+  for (int r = 0; r < commsize; ++r) {
+    auto [rbeg, rend] = rowsOf(r);
+    displs[r] = JSIZE * rbeg, counts[r] = JSIZE * (rend - rbeg);
   }
 
-  std::cout << "Elapsed time " << (toc - tic) * 1000 << " ms" << std::endl;
-
-  std::ofstream of(filename.data());
-  if (!of) {
-    std::cerr << "Cannot open file for results" << std::endl;
-    return;
+  ArrTy resA{}, resB{};
+  if (rank == 0)
+    resA = ArrTy{ISIZE, JSIZE}, resB = ArrTy{ISIZE, JSIZE};
+  auto gatherRows = [&](const ArrTy &loc, ArrTy &res) {
+    MPI::COMM_WORLD.Gatherv(loc.data(), counts[rank], MPI::DOUBLE, res.data(),
+                            counts.data(), displs.data(), MPI::DOUBLE, 0);
+  };
+
+#pragma omp parallel
+#pragma omp master
+  {
+#pragma omp task if (commTasks)
+    gatherRows(a, resA);
+
+#pragma omp taskloop
+    for (std::size_t i = 0; i < brows; ++i)
+      bRow(i);
+
+    // Only the part of the a gather not hidden by b is counted
+    timer.time(lab::Phase::Comm, [] {
+#pragma omp taskwait
+    });
   }
-  dumper(a, of);
-  dumper(b, of);
-}
 
-void initArr(ArrTy &a, ArrTy &b) {
-  a.resize(ISIZE);
-  b.resize(ISIZE);
-  // Fill array with data
-  for (std::size_t i = 0; i < a.size(); i++) {
-    auto &ai = a[i];
-    ai.resize(JSIZE);
-    b[i].resize(JSIZE);
-    for (std::size_t j = 0; j < ai.size(); j++)
-      ai[j] = 10 * i + j;
-  }
-}
+  timer.time(lab::Phase::Comm, [&] { gatherRows(b, resB); });
 
-void initTArr(ArrTy &a, ArrTy &b) {
-  a.resize(JSIZE);
-  b.resize(JSIZE);
-  // Fill array with data
-  for (std::size_t j = 0; j < a.size(); j++) {
-    auto &aj = a[j];
-    aj.resize(ISIZE);
-    b[j].resize(ISIZE);
-    for (std::size_t i = 0; i < aj.size(); i++)
-      aj[i] = 10 * i + j;
-  }
+  if (rank != 0)
+    return {};
+  part = {std::move(resA), std::move(resB)};
+  return {0, 0, ISIZE, JSIZE};
 }
 
-void printTArr(const ArrTy &a, std::ostream &ost) {
-  for (std::size_t i = 0; i < a.size(); ++i) {
-    for (std::size_t j = 0; j < a[i].size(); ++j)
-      ost << a[j][i] << " ";
-    ost << std::endl;
-  }
+// Runs f on fresh arrays and writes its results, as many times as cfg
+// says; returns this rank's timings
+lab::BenchRecord measureDump(InitFunc init, ProcFunc f, std::string_view name,
+                             Format fmt, const lab::BenchConfig &cfg) {
+  Local loc{};
+  lab::Block blk{};
+  lab::BenchCase bc{
+      [&] { init(loc); }, [&](lab::PhaseTimer &timer) { blk = f(loc, timer); },
+      [&] {
+        lab::DumpWriter out{MPI::COMM_WORLD, dumpName(name, fmt), fmt};
+        auto part = blk.empty() ? lab::Block{}
+                                : lab::Block{blk.i0 - loc.i0, 0, blk.rows,
+                                             blk.cols};
+        out.write(ISIZE, JSIZE, blk, std::as_const(loc.a).block(part));
+        out.write(ISIZE, JSIZE, blk, std::as_const(loc.b).block(part));
+      }};
+
+  return {std::string{name},
+          MPI::COMM_WORLD.Get_rank(),
+          MPI::COMM_WORLD.Get_size(),
+          omp_get_max_threads(),
+          ISIZE,
+          JSIZE,
+          cfg.repeats,
+          lab::runBench(bc, cfg)};
 }
 
-void doSeq() {
-  ArrTy a{};
-  ArrTy b{};
-  initArr(a, b);
-
-  std::cout << "Sequential:" << std::endl;
-  measureDump(processArr, a, b, "seq.txt", printArr);
+void printTimes(const lab::BenchRecord &rec) {
+  auto &&stats = rec.stats;
+  auto ms = [&stats](lab::Phase phase) {
+    return stats[static_cast<std::size_t>(phase)].median * 1000;
+  };
+  std::cout << "Elapsed time " << ms(lab::Phase::Compute) + ms(lab::Phase::Comm)
+            << " ms" << std::endl;
+  std::cout << "Dump time " << ms(lab::Phase::Output) << " ms" << std::endl;
 }
 
-void doPar() {
-  ArrTy aT{};
-  ArrTy bT{};
-  initTArr(aT, bT);
-
-  if (MPI::COMM_WORLD.Get_rank() == 0)
-    std::cout << "Parallel:" << std::endl;
-  measureDump(processArrPar, aT, bT, "par.txt", printTArr);
-}
+int main(int argc, char *argv[]) {
+  // Hybrid run: OMP_NUM_THREADS threads per rank, communication tasks need
+  // MPI from any thread
+  commTasks = MPI::Init_thread(argc, argv, MPI::THREAD_MULTIPLE) ==
+              MPI::THREAD_MULTIPLE;
+  auto rank = MPI::COMM_WORLD.Get_rank();
+  auto commsz = MPI::COMM_WORLD.Get_size();
+  // "gather": collect parallel results on rank 0 before writing them
+  // "text": write text dumps instead of binary ones
+  // "sin=libm|ulp1|fast": row sine kernel
+  // "size=IxJ", "bench=N", "warmup=N", "report=csv|json": see bench.hh
+  bool gather = false;
+  auto fmt = Format::Binary;
+  lab::BenchArgs args{};
+  try {
+    for (int i = 1; i < argc; ++i) {
+      std::string_view arg{argv[i]};
+      gather = gather || arg == "gather";
+      if (arg == "text")
+        fmt = Format::Text;
+      if (arg.starts_with("sin="))
+        rowSin = lab::rowSinByName(arg.substr(4));
+      lab::parseBenchArg(arg, args);
+    }
+  } catch (const std::invalid_argument &err) {
+    if (rank == 0)
+      std::cerr << err.what() << std::endl;
+    MPI::Finalize();
+    return 1;
+  }
 
-void doEth() {
-  ArrTy a{};
-  ArrTy b{};
-  initArr(a, b);
+  if (rowSin == nullptr) {
+    if (rank == 0)
+      std::cerr << "Unknown sine kernel" << std::endl;
+    MPI::Finalize();
+    return 1;
+  }
 
-  if (MPI::COMM_WORLD.Get_rank() == 0)
-    std::cout << "Ethalon:" << std::endl;
-  measureDump(ethalon, a, b, "eth.txt", printArr);
-}
+  if (args.rows != 0)
+    ISIZE = args.rows, JSIZE = args.cols;
+  if (ISIZE <= IDIST || JSIZE <= JDIST) {
+    if (rank == 0)
+      std::cerr << "Array must be larger than 3x5" << std::endl;
+    MPI::Finalize();
+    return 1;
+  }
 
-int main(int argc, char *argv[]) {
-  MPI::Init(argc, argv);
-  auto commsz = MPI::COMM_WORLD.Get_size();
+  // Without "bench" every version runs once and prints its times
+  auto cfg = args.bench ? args.cfg : lab::BenchConfig{0, 1};
+  cfg.sync = [] { MPI::COMM_WORLD.Barrier(); };
 
+  struct Case {
+    std::string_view name, title;
+    InitFunc init;
+    ProcFunc func;
+  };
+  std::vector<Case> cases{};
   if (commsz == 1)
-    doSeq();
-  doPar();
-  doEth();
+    cases.push_back({"seq", "Sequential:", initArr, processArr});
+  cases.push_back({"par", "Parallel:",
+                   [](Local &loc) { initRows(loc, IDIST); },
+                   [gather](Local &loc, lab::PhaseTimer &timer) {
+                     return processArrPar(loc, timer, gather);
+                   }});
+  cases.push_back(
+      {"eth", "Ethalon:", [](Local &loc) { initRows(loc, 0); }, ethalon});
+
+  std::vector<lab::BenchRecord> records{};
+  for (auto &&[name, title, init, func] : cases) {
+    if (!args.bench && rank == 0)
+      std::cout << title << std::endl;
+
+    auto rec = measureDump(init, func, name, fmt, cfg);
+    if (!args.bench && rank == 0)
+      printTimes(rec);
+
+    auto all = lab::gatherRecords(MPI::COMM_WORLD, rec);
+    records.insert(records.end(), all.begin(), all.end());
+  }
+
+  if (args.bench && rank == 0)
+    lab::writeReport(std::cout, records, args.fmt);
 
   MPI::Finalize();
 }
@@ -0,0 +1,151 @@
+#ifndef __SEM7_OPENMP_8_MATMUL_BITMATRIX_HH__
+#define __SEM7_OPENMP_8_MATMUL_BITMATRIX_HH__
+
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include <omp.h>
+
+#include "matrix.hh"
+
+namespace linal {
+
+// Boolean matrix, 64 entries per word. Rows are padded to whole words,
+// padding bits are always zero.
+class BitMatrix final {
+public:
+  using word = std::uint64_t;
+  static constexpr std::size_t WBITS = 64;
+
+private:
+  std::vector<word> data_;
+  std::size_t rows_ = 0, cols_ = 0, wcols_ = 0;
+
+public:
+  BitMatrix(std::size_t rows = 0, std::size_t cols = 0)
+      : rows_(rows), cols_(cols), wcols_((cols + WBITS - 1) / WBITS) {
+    data_.resize(rows_ * wcols_);
+  }
+
+  // Nonzero elements become set bits
+  template <typename T>
+  explicit BitMatrix(const Matrix<T> &mat)
+      : BitMatrix(mat.getRows(), mat.getCols()) {
+#pragma omp parallel for schedule(static)
+    for (std::size_t i = 0; i < rows_; ++i)
+      for (std::size_t j = 0; j < cols_; ++j)
+        if (mat[i][j] != T{})
+          set(i, j);
+  }
+
+  template <typename T> Matrix<T> toMatrix() const {
+    return Matrix<T>{rows_, cols_, [this](auto i, auto j) {
+                       return static_cast<T>(get(i, j));
+                     }};
+  }
+
+  static BitMatrix Identity(std::size_t rows) {
+    BitMatrix id{rows, rows};
+    for (std::size_t i = 0; i < rows; ++i)
+      id.set(i, i);
+
+    return id;
+  }
+
+  bool get(std::size_t i, std::size_t j) const {
+    return (data_[i * wcols_ + j / WBITS] >> (j % WBITS)) & 1;
+  }
+
+  void set(std::size_t i, std::size_t j, bool val = true) {
+    auto &&wrd = data_[i * wcols_ + j / WBITS];
+    auto mask = word{1} << (j % WBITS);
+    wrd = val ? (wrd | mask) : (wrd & ~mask);
+  }
+
+  word *row(std::size_t i) { return data_.data() + i * wcols_; }
+  const word *row(std::size_t i) const { return data_.data() + i * wcols_; }
+
+  std::size_t getRows() const { return rows_; }
+  std::size_t getCols() const { return cols_; }
+  std::size_t getWordCols() const { return wcols_; }
+
+  // Amount of set bits
+  std::size_t count() const {
+    std::size_t res = 0;
+    for (auto wrd : data_)
+      res += std::popcount(wrd);
+    return res;
+  }
+
+  BitMatrix &operator|=(const BitMatrix &mat) {
+    for (std::size_t i = 0; i < data_.size(); ++i)
+      data_[i] |= mat.data_[i];
+    return *this;
+  }
+
+  bool operator==(const BitMatrix &mat) const {
+    return rows_ == mat.rows_ && cols_ == mat.cols_ && data_ == mat.data_;
+  }
+};
+
+} // namespace linal
+
+namespace mul {
+
+// Boolean product over (OR, AND): row i of result is OR of rhs rows k for
+// every set bit k of lhs row i. Set bits are enumerated by word, so the
+// work is proportional to the amount of ones in lhs, 64 columns of rhs
+// are processed by one word operation.
+linal::BitMatrix mulBool(const linal::BitMatrix &lhs,
+                         const linal::BitMatrix &rhs) {
+  using word = linal::BitMatrix::word;
+
+  if (lhs.getCols() != rhs.getRows())
+    throw std::invalid_argument{"Incompatible matrix sizes"};
+
+  linal::BitMatrix res{lhs.getRows(), rhs.getCols()};
+  std::size_t res_r = res.getRows(), lhs_w = lhs.getWordCols(),
+              res_w = res.getWordCols();
+
+#pragma omp parallel for schedule(dynamic, 16)
+  for (std::size_t i = 0; i < res_r; ++i) {
+    auto rptr = res.row(i);
+    auto lptr = lhs.row(i);
+
+    for (std::size_t kw = 0; kw < lhs_w; ++kw)
+      for (word bits = lptr[kw]; bits != 0; bits &= bits - 1) {
+        auto k = kw * linal::BitMatrix::WBITS + std::countr_zero(bits);
+        auto bptr = rhs.row(k);
+        for (std::size_t w = 0; w < res_w; ++w)
+          rptr[w] |= bptr[w];
+      }
+  }
+
+  return res;
+}
+
+// Reflexive-transitive closure by repeated squaring of (A | I): stops as
+// soon as squaring adds no new pairs, at most log2(n) products.
+linal::BitMatrix transitiveClosure(const linal::BitMatrix &adj) {
+  if (adj.getRows() != adj.getCols())
+    throw std::invalid_argument{"Adjacency matrix must be square"};
+
+  auto reach = linal::BitMatrix::Identity(adj.getRows());
+  reach |= adj;
+
+  for (;;) {
+    auto next = mulBool(reach, reach);
+    if (next == reach)
+      return reach;
+    reach = std::move(next);
+  }
+}
+
+} // namespace mul
+
+#endif // __SEM7_OPENMP_8_MATMUL_BITMATRIX_HH__
@@ -0,0 +1,233 @@
+#ifndef __SEM7_OPENMP_8_MATMUL_ENGINE_HH__
+#define __SEM7_OPENMP_8_MATMUL_ENGINE_HH__
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <future>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include <immintrin.h>
+
+#include "matmul.hh"
+
+namespace mul {
+
+// Fill rows [from, to) of res with lhs * rhs. Row-oriented (i-k-j) kernel:
+// rhs rows are streamed as is, so no transposed copy is needed.
+void mulRowsIntr(const Mat &lhs, const Mat &rhs, Mat &res, std::size_t from,
+                 std::size_t to) noexcept {
+  std::size_t res_c = res.getCols(), com_sz = lhs.getCols(),
+              end_j = res_c - res_c % 8;
+
+  for (std::size_t i = from; i < to; ++i) {
+    auto rptr = res[i];
+    const auto lptr = lhs[i];
+    std::fill(rptr, rptr + res_c, 0);
+
+    for (std::size_t k = 0; k < com_sz; ++k) {
+      const auto bptr = rhs[k];
+      auto lhs_v = _mm256_set1_epi32(lptr[k]);
+
+      std::size_t j = 0;
+      for (; j < end_j; j += 8) {
+        auto res_p = reinterpret_cast<__m256i *>(rptr + j);
+        auto rhs_v =
+            _mm256_loadu_si256(reinterpret_cast<const __m256i *>(bptr + j));
+        auto res_v = _mm256_loadu_si256(res_p);
+
+        res_v = _mm256_add_epi32(res_v, _mm256_mullo_epi32(lhs_v, rhs_v));
+        _mm256_storeu_si256(res_p, res_v);
+      }
+
+      for (; j < res_c; ++j)
+        rptr[j] += lptr[k] * bptr[j];
+    }
+  }
+}
+
+// Long-lived multiplication service. Workers are started once; every
+// submitted job is split into row chunks which are put into one shared
+// queue, so independent jobs are processed by the same threads without
+// creating thread teams per call.
+//
+// Operands and result are referenced, not copied: they must stay alive
+// until the returned future becomes ready.
+class Engine final {
+public:
+  struct Job {
+    const Mat *lhs;
+    const Mat *rhs;
+    Mat *res;
+  };
+
+  // Jobs smaller than this many multiply-adds are never split
+  static constexpr std::size_t MIN_CHUNK_WORK = 1 << 16;
+
+private:
+  struct JobState {
+    Job job;
+    std::promise<void> done;
+    std::atomic<std::size_t> left;
+  };
+
+  struct Chunk {
+    std::shared_ptr<JobState> state;
+    std::size_t from, to;
+  };
+
+  std::vector<std::thread> workers_;
+  std::deque<Chunk> queue_;
+  std::mutex mtx_;
+  std::condition_variable cv_;
+  bool stop_ = false;
+
+public:
+  explicit Engine(std::size_t tnum = std::thread::hardware_concurrency()) {
+    tnum = std::max<std::size_t>(tnum, 1);
+    std::generate_n(std::back_inserter(workers_), tnum,
+                    [this] { return std::thread{&Engine::run, this}; });
+  }
+
+  Engine(const Engine &) = delete;
+  Engine &operator=(const Engine &) = delete;
+
+  ~Engine() {
+    {
+      std::lock_guard guard{mtx_};
+      stop_ = true;
+    }
+    cv_.notify_all();
+
+    for (auto &&worker : workers_)
+      worker.join();
+  }
+
+  std::size_t getThreadNum() const { return workers_.size(); }
+
+  // res = lhs * rhs, res must already have the size of the product
+  std::future<void> submit(const Mat &lhs, const Mat &rhs, Mat &res) {
+    Job job{&lhs, &rhs, &res};
+    check(job);
+
+    std::vector<Chunk> chunks{};
+    auto fut = prepare(job, chunks);
+    enqueue(chunks);
+
+    return fut;
+  }
+
+  // Enqueue several jobs under one lock. If one of them is invalid or
+  // cannot be set up, none is run and every future of the batch holds the
+  // error.
+  std::vector<std::future<void>> submit(const std::vector<Job> &jobs) {
+    std::vector<Chunk> chunks{};
+    std::vector<std::future<void>> futs{};
+    futs.reserve(jobs.size());
+
+    try {
+      for (auto &&job : jobs)
+        check(job);
+      for (auto &&job : jobs)
+        futs.push_back(prepare(job, chunks));
+    } catch (...) {
+      auto err = std::current_exception();
+      futs.clear();
+      std::generate_n(std::back_inserter(futs), jobs.size(), [err] {
+        std::promise<void> failed{};
+        failed.set_exception(err);
+        return failed.get_future();
+      });
+      return futs;
+    }
+    enqueue(chunks);
+
+    return futs;
+  }
+
+private:
+  static void check(const Job &job) {
+    if (job.lhs->getCols() != job.rhs->getRows())
+      throw std::invalid_argument{"Incompatible matrix sizes"};
+    if (job.res->getRows() != job.lhs->getRows() ||
+        job.res->getCols() != job.rhs->getCols())
+      throw std::invalid_argument{"Result matrix has wrong size"};
+  }
+
+  std::future<void> prepare(const Job &job, std::vector<Chunk> &chunks) {
+    auto state = std::make_shared<JobState>();
+    state->job = job;
+    auto fut = state->done.get_future();
+
+    std::size_t nrows = job.res->getRows();
+    if (job.res->empty()) {
+      state->done.set_value();
+      return fut;
+    }
+
+    auto row_work =
+        std::max<std::size_t>(job.res->getCols() * job.lhs->getCols(), 1);
+    auto min_rows = (MIN_CHUNK_WORK + row_work - 1) / row_work;
+    auto per_thread = (nrows + workers_.size() - 1) / workers_.size();
+    auto block = std::max(min_rows, per_thread);
+
+    state->left = (nrows + block - 1) / block;
+    for (std::size_t from = 0; from < nrows; from += block)
+      chunks.push_back({state, from, std::min(from + block, nrows)});
+
+    return fut;
+  }
+
+  void enqueue(const std::vector<Chunk> &chunks) {
+    {
+      std::lock_guard guard{mtx_};
+      queue_.insert(queue_.end(), chunks.begin(), chunks.end());
+    }
+    cv_.notify_all();
+  }
+
+  void run() {
+    for (;;) {
+      Chunk chunk{};
+      {
+        std::unique_lock lock{mtx_};
+        cv_.wait(lock, [this] { return stop_ || !queue_.empty(); });
+        if (queue_.empty())
+          return;
+
+        chunk = std::move(queue_.front());
+        queue_.pop_front();
+      }
+
+      // Sizes are checked on submission, the kernel itself cannot fail
+      auto &&state = *chunk.state;
+      mulRowsIntr(*state.job.lhs, *state.job.rhs, *state.job.res, chunk.from,
+                  chunk.to);
+
+      if (--state.left == 0)
+        state.done.set_value();
+    }
+  }
+};
+
+// MulFunc adapter over process-wide engine
+Mat mulEngine(const Mat &lhs, const Mat &rhs) {
+  static Engine engine{};
+
+  Mat res{lhs.getRows(), rhs.getCols()};
+  engine.submit(lhs, rhs, res).get();
+
+  return res;
+}
+
+} // namespace mul
+
+#endif // __SEM7_OPENMP_8_MATMUL_ENGINE_HH__
@@ -0,0 +1,190 @@
+#ifndef __SEM7_OPENMP_8_MATMUL_GEMM_HH__
+#define __SEM7_OPENMP_8_MATMUL_GEMM_HH__
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <tuple>
+#include <vector>
+
+#include <immintrin.h>
+#include <omp.h>
+
+#include "matmul.hh"
+
+namespace mul {
+
+// Operand form: as is or transposed
+enum class Op { N, T };
+
+// Element-wise epilogues applied to alpha * op(A) * op(B) + beta * C
+// right before the value is stored. Each one is a functor of
+// (value, row, col).
+namespace epi {
+struct None {
+  std::int32_t operator()(std::int32_t val, std::size_t, std::size_t) const {
+    return val;
+  }
+};
+
+struct Relu {
+  std::int32_t operator()(std::int32_t val, std::size_t, std::size_t) const {
+    return std::max(val, 0);
+  }
+};
+
+struct Clamp {
+  std::int32_t lo, hi;
+
+  std::int32_t operator()(std::int32_t val, std::size_t, std::size_t) const {
+    return std::clamp(val, lo, hi);
+  }
+};
+
+// Per-column bias, bias must hold at least C.getCols() values
+struct AddBias {
+  const std::int32_t *bias;
+
+  std::int32_t operator()(std::int32_t val, std::size_t,
+                          std::size_t j) const {
+    return val + bias[j];
+  }
+};
+
+// Apply epilogues left to right
+template <typename... Fs> struct Chain {
+  std::tuple<Fs...> fncs;
+
+  std::int32_t operator()(std::int32_t val, std::size_t i,
+                          std::size_t j) const {
+    std::apply([&](auto &&...fnc) { ((val = fnc(val, i, j)), ...); }, fncs);
+    return val;
+  }
+};
+
+template <typename... Fs> Chain<Fs...> chain(Fs... fncs) {
+  return {{fncs...}};
+}
+} // namespace epi
+
+std::int32_t dotIntr(const std::int32_t *lptr, const std::int32_t *rptr,
+                     std::size_t size) {
+  std::size_t k = 0, end_k = size - size % 8;
+  auto sum = _mm256_setzero_si256();
+
+  for (; k < end_k; k += 8) {
+    auto lhs_v =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(lptr + k));
+    auto rhs_v =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(rptr + k));
+
+    sum = _mm256_add_epi32(sum, _mm256_mullo_epi32(lhs_v, rhs_v));
+  }
+
+  auto swp128 = _mm256_permute2x128_si256(sum, sum, 1);
+  auto sum128 = _mm256_castsi256_si128(_mm256_add_epi32(sum, swp128));
+
+  auto swp64 = _mm_shuffle_epi32(sum128, _MM_SHUFFLE(1, 0, 3, 2));
+  auto sum64 = _mm_add_epi32(swp64, sum128);
+
+  auto swp32 = _mm_shuffle_epi32(sum64, _MM_SHUFFLE2(0, 1));
+  auto sum32 = _mm_add_epi32(swp32, sum64);
+
+  std::int32_t res = _mm_cvtsi128_si32(sum32);
+  for (; k < size; ++k)
+    res += lptr[k] * rptr[k];
+
+  return res;
+}
+
+// acc += val * src
+void axpyIntr(std::int32_t *acc, std::int32_t val, const std::int32_t *src,
+              std::size_t size) {
+  std::size_t j = 0, end_j = size - size % 8;
+  auto val_v = _mm256_set1_epi32(val);
+
+  for (; j < end_j; j += 8) {
+    auto acc_p = reinterpret_cast<__m256i *>(acc + j);
+    auto src_v =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + j));
+    auto acc_v = _mm256_loadu_si256(acc_p);
+
+    acc_v = _mm256_add_epi32(acc_v, _mm256_mullo_epi32(val_v, src_v));
+    _mm256_storeu_si256(acc_p, acc_v);
+  }
+
+  for (; j < size; ++j)
+    acc[j] += val * src[j];
+}
+
+// C = epilogue(alpha * op(A) * op(B) + beta * C), in place.
+// Transposed operands are never materialized: a row of op(A) is either a
+// row of A or a column of A gathered into a K-sized buffer, and op(B) is
+// consumed as rows (axpy) or as transposed rows (dot products).
+// With beta == 0 previous contents of C are not read. C must not be A or
+// B: its rows are stored while later rows of A and all of B are still read.
+template <typename Epilogue = epi::None>
+void gemm(Op op_a, Op op_b, std::int32_t alpha, const Mat &a, const Mat &b,
+          std::int32_t beta, Mat &c, Epilogue epilogue = {}) {
+  if (&c == &a || &c == &b)
+    throw std::invalid_argument{"Result matrix aliases an operand"};
+
+  bool trans_a = op_a == Op::T, trans_b = op_b == Op::T;
+  std::size_t res_r = trans_a ? a.getCols() : a.getRows(),
+              com_sz = trans_a ? a.getRows() : a.getCols(),
+              res_c = trans_b ? b.getRows() : b.getCols(),
+              com_b = trans_b ? b.getCols() : b.getRows();
+
+  if (com_sz != com_b)
+    throw std::invalid_argument{"Incompatible matrix sizes"};
+  if (c.getRows() != res_r || c.getCols() != res_c)
+    throw std::invalid_argument{"Result matrix has wrong size"};
+  if (c.empty())
+    return;
+
+#pragma omp parallel
+  {
+    std::vector<std::int32_t> acc(res_c), col(trans_a ? com_sz : 0);
+
+#pragma omp for schedule(static)
+    for (std::size_t i = 0; i < res_r; ++i) {
+      const std::int32_t *lptr = nullptr;
+      if (trans_a) {
+        for (std::size_t k = 0; k < com_sz; ++k)
+          col[k] = a[k][i];
+        lptr = col.data();
+      } else
+        lptr = a[i];
+
+      if (trans_b)
+        for (std::size_t j = 0; j < res_c; ++j)
+          acc[j] = dotIntr(lptr, b[j], com_sz);
+      else {
+        std::fill(acc.begin(), acc.end(), 0);
+        for (std::size_t k = 0; k < com_sz; ++k)
+          axpyIntr(acc.data(), lptr[k], b[k], res_c);
+      }
+
+      auto cptr = c[i];
+      if (beta == 0)
+        for (std::size_t j = 0; j < res_c; ++j)
+          cptr[j] = epilogue(alpha * acc[j], i, j);
+      else
+        for (std::size_t j = 0; j < res_c; ++j)
+          cptr[j] = epilogue(alpha * acc[j] + beta * cptr[j], i, j);
+    }
+  }
+}
+
+// MulFunc adapter: plain product through GEMM path
+Mat mulGemm(const Mat &lhs, const Mat &rhs) {
+  Mat res{lhs.getRows(), rhs.getCols()};
+  gemm(Op::N, Op::N, 1, lhs, rhs, 0, res);
+
+  return res;
+}
+
+} // namespace mul
+
+#endif // __SEM7_OPENMP_8_MATMUL_GEMM_HH__
@@ -1,4 +1,254 @@
-#include "matmul.hh"
+#include "bitmatrix.hh"
+#include "engine.hh"
+#include "gemm.hh"
+#include "power.hh"
+#include "rand.hh"
+#include "semiring.hh"
+
+// Runs f, returns its result and time in ms
+template <typename F> auto measure(F f) {
+  timer::Timer timer;
+  auto answ = f();
+  auto ms = static_cast<linal::ldbl>(timer.elapsed_mcs()) / 1'000;
+
+  return std::pair{std::move(answ), ms};
+}
+
+// Reference all-pairs shortest paths
+mul::Mat floydWarshall(mul::Mat dist) {
+  std::size_t size = dist.getRows();
+  for (std::size_t i = 0; i < size; ++i)
+    dist[i][i] = std::min(dist[i][i], 0);
+
+  for (std::size_t k = 0; k < size; ++k)
+    for (std::size_t i = 0; i < size; ++i)
+      for (std::size_t j = 0; j < size; ++j)
+        dist[i][j] = std::min(dist[i][j], dist[i][k] + dist[k][j]);
+
+  return dist;
+}
+
+// Reference reflexive-transitive closure: BFS from every vertex
+linal::BitMatrix bfsClosure(const linal::BitMatrix &adj) {
+  std::size_t size = adj.getRows();
+  std::vector<std::vector<std::size_t>> edges(size);
+  for (std::size_t i = 0; i < size; ++i)
+    for (std::size_t j = 0; j < size; ++j)
+      if (adj.get(i, j))
+        edges[i].push_back(j);
+
+  linal::BitMatrix reach{size, size};
+  std::vector<std::size_t> queue{};
+  for (std::size_t src = 0; src < size; ++src) {
+    queue.assign(1, src);
+    reach.set(src, src);
+    for (std::size_t head = 0; head < queue.size(); ++head)
+      for (auto dst : edges[queue[head]])
+        if (!reach.get(src, dst)) {
+          reach.set(src, dst);
+          queue.push_back(dst);
+        }
+  }
+
+  return reach;
+}
+
+// Same closure by squaring with int32 (OR, AND) products, the baseline
+// the bit-packed one replaces
+mul::Mat closureInt(mul::Mat reach) {
+  for (std::size_t i = 0; i < reach.getRows(); ++i)
+    reach[i][i] = 1;
+
+  for (;;) {
+    auto next = mul::mulSemiring<mul::sr::OrAnd>(reach, reach);
+    if (next == reach)
+      return reach;
+    reach = std::move(next);
+  }
+}
+
+// Min-plus shortest paths and the bit-packed closure on a random graph,
+// about 2 edges per vertex, checked against the plain algorithms
+void CompareGraphs(std::size_t size) {
+  constexpr std::uint64_t SEED = 42;
+  auto has_edge = rnd::randMatrix<std::int32_t>(
+      size, size, SEED, rnd::Uniform<std::int32_t>{0, std::int32_t(size)});
+  auto weight = rnd::randMatrix<std::int32_t>(
+      size, size, SEED + 1, rnd::Uniform<std::int32_t>{1, 100});
+
+  mul::Mat weights{size, size, [&](auto i, auto j) {
+                     return has_edge[i][j] < 2 ? weight[i][j]
+                                               : mul::sr::MinPlus::INF;
+                   }};
+  mul::Mat adj{size, size,
+               [&](auto i, auto j) { return has_edge[i][j] < 2 ? 1 : 0; }};
+
+  std::cout << "Graph: " << size << " vertices" << std::endl;
+
+  std::cout << "Shortest paths, Floyd-Warshall\n";
+  auto dist = measure([&] { return floydWarshall(weights); });
+  std::cout << dist.second << " ms" << std::endl;
+
+  std::cout << "Shortest paths, min-plus squaring + SIMD\n";
+  auto dist_sr = measure([&] { return mul::shortestPaths(weights); });
+  std::cout << dist_sr.second << " ms" << std::endl;
+  assert(dist_sr.first == dist.first);
+
+  linal::BitMatrix adj_bits{adj};
+  std::cout << "Transitive closure, BFS\n";
+  auto reach = measure([&] { return bfsClosure(adj_bits); });
+  std::cout << reach.second << " ms" << std::endl;
+
+  std::cout << "Transitive closure, int32 (OR, AND) squaring\n";
+  auto reach_int = measure([&] { return closureInt(adj); });
+  std::cout << reach_int.second << " ms, "
+            << size * size * sizeof(std::int32_t) << " bytes per matrix"
+            << std::endl;
+  assert(linal::BitMatrix{reach_int.first} == reach.first);
+
+  std::cout << "Transitive closure, bit-packed squaring\n";
+  auto reach_bits = measure([&] { return mul::transitiveClosure(adj_bits); });
+  std::cout << reach_bits.second << " ms, "
+            << size * adj_bits.getWordCols() * sizeof(linal::BitMatrix::word)
+            << " bytes per matrix" << std::endl;
+  assert(reach_bits.first == reach.first);
+}
+
+// gemm with every operand form, beta != 0 and fused epilogues, checked
+// against answ = lhs * rhs
+void CompareGemm(const mul::Mat &lhs, const mul::Mat &rhs,
+                 const mul::Mat &answ) {
+  using mul::Op;
+  constexpr std::int32_t ALPHA = 2, BETA = -3;
+  std::size_t rows = answ.getRows(), cols = answ.getCols();
+
+  mul::Mat lhs_t{lhs.Transposing()}, rhs_t{rhs.Transposing()};
+  auto c0 = rnd::randMatrix<std::int32_t>(
+      rows, cols, 9, rnd::Uniform<std::int32_t>{-100, 100});
+  auto bias_m = rnd::randMatrix<std::int32_t>(
+      1, cols, 10, rnd::Uniform<std::int32_t>{-100, 100});
+  std::vector<std::int32_t> bias(bias_m[0], bias_m[0] + cols);
+
+  auto expect = [&](std::int32_t beta, auto epilogue) {
+    return mul::Mat{rows, cols, [&](auto i, auto j) {
+                      return epilogue(ALPHA * answ[i][j] + beta * c0[i][j], i,
+                                      j);
+                    }};
+  };
+  auto run = [&](Op op_a, Op op_b, std::int32_t beta, auto epilogue) {
+    return measure([&] {
+      auto c = c0;
+      mul::gemm(op_a, op_b, ALPHA, op_a == Op::T ? lhs_t : lhs,
+                op_b == Op::T ? rhs_t : rhs, beta, c, epilogue);
+      return c;
+    });
+  };
+
+  for (auto op_a : {Op::N, Op::T})
+    for (auto op_b : {Op::N, Op::T}) {
+      std::cout << "GEMM " << (op_a == Op::T ? "T" : "N")
+                << (op_b == Op::T ? "T" : "N") << ", alpha = " << ALPHA
+                << ", beta = " << BETA << "\n";
+      auto res = run(op_a, op_b, BETA, mul::epi::None{});
+      std::cout << res.second << " ms" << std::endl;
+      assert(res.first == expect(BETA, mul::epi::None{}));
+    }
+
+  std::cout << "GEMM NN + Relu\n";
+  auto res = run(Op::N, Op::N, 0, mul::epi::Relu{});
+  std::cout << res.second << " ms" << std::endl;
+  assert(res.first == expect(0, mul::epi::Relu{}));
+
+  auto bias_clamp = mul::epi::chain(mul::epi::AddBias{bias.data()},
+                                    mul::epi::Clamp{-50, 50});
+  std::cout << "GEMM NN + Chain<AddBias, Clamp>\n";
+  res = run(Op::N, Op::N, BETA, bias_clamp);
+  std::cout << res.second << " ms" << std::endl;
+  assert(res.first == expect(BETA, bias_clamp));
+
+  bool thrown = false;
+  try {
+    auto c = lhs;
+    mul::gemm(Op::N, Op::N, 1, c, rhs, 0, c);
+  } catch (const std::invalid_argument &) {
+    thrown = true;
+  }
+  assert(thrown);
+}
+
+// Reference m^k: k - 1 plain products, wrapping or modulo mod > 1
+mul::Mat refPower(const mul::Mat &m, std::uint64_t k, std::uint32_t mod) {
+  auto mulMod = [mod](const mul::Mat &lhs, const mul::Mat &rhs) {
+    // int32 wrapping keeps products modulo 2^31 right
+    if (mod == 0 || mod == (std::uint32_t{1} << 31)) {
+      auto res = mul::mulNaive(lhs, rhs);
+      return mod == 0 ? res : mul::reduceMod(res, mod);
+    }
+
+    mul::Mat res{lhs.getRows(), rhs.getCols()};
+    for (std::size_t i = 0; i < res.getRows(); ++i)
+      for (std::size_t j = 0; j < res.getCols(); ++j) {
+        std::uint64_t acc = 0;
+        for (std::size_t l = 0; l < lhs.getCols(); ++l)
+          acc = (acc + std::uint64_t(lhs[i][l]) * std::uint64_t(rhs[l][j])) %
+                mod;
+        res[i][j] = static_cast<std::int32_t>(acc);
+      }
+    return res;
+  };
+
+  auto base = mod != 0 ? mul::reduceMod(m, mod) : m;
+  if (k == 0)
+    return mul::Mat::Identity(m.getRows());
+
+  auto res = base;
+  for (std::uint64_t i = 1; i < k; ++i)
+    res = mulMod(res, base);
+  return res;
+}
+
+// power and powerApply on a random matrix: wrapping and modular results
+// checked against plain products, then their scaling over threads
+void ComparePowers(std::size_t size) {
+  auto m = rnd::randMatrix<std::int32_t>(size, size, 7,
+                                         rnd::Uniform<std::int32_t>{-50, 50});
+  auto vec_m = rnd::randMatrix<std::int32_t>(
+      1, size, 8, rnd::Uniform<std::int32_t>{-50, 50});
+  std::vector<std::int32_t> vec(vec_m[0], vec_m[0] + size);
+
+  constexpr std::uint64_t K = 13;
+  std::cout << "Matrix power: " << size << " x " << size << ", k = " << K
+            << std::endl;
+
+  for (std::uint32_t mod : {0u, 1'000'000'007u, (1u << 31) - 1, 1u << 31}) {
+    for (std::uint64_t k : {std::uint64_t{0}, std::uint64_t{1}, K}) {
+      auto want = refPower(m, k, mod);
+      assert(mul::power(m, k, mod) == want);
+
+      std::vector<std::int32_t> want_v(size);
+      for (std::size_t i = 0; i < size; ++i) {
+        std::int64_t acc = 0;
+        for (std::size_t j = 0; j < size; ++j)
+          acc += std::int64_t{want[i][j]} * vec[j];
+        want_v[i] = static_cast<std::int32_t>(
+            mod == 0 ? static_cast<std::uint32_t>(acc)
+                     : ((acc % mod) + mod) % mod);
+      }
+      assert(mul::powerApply(m, vec, k, mod) == want_v);
+    }
+
+    std::cout << (mod == 0 ? "Wrapping" : "Modulo " + std::to_string(mod))
+              << ", threads: power ms, powerApply ms\n";
+    for (auto tnum : mul::threadCounts()) {
+      omp_set_num_threads(tnum);
+      auto pow = measure([&] { return mul::power(m, K, mod); });
+      auto app = measure([&] { return mul::powerApply(m, vec, K, mod); });
+      std::cout << tnum << ": " << pow.second << ", " << app.second
+                << std::endl;
+    }
+    omp_set_num_threads(mul::threadCounts().back());
+  }
+}
 
 int CompareWays() {
   mul::Mat mat1, mat2, answ;
@@ -43,6 +293,11 @@ int CompareWays() {
   std::cout << res.second << " ms" << std::endl;
   assert(res.first == answ);
 
+  std::cout << "OMP Winograd inner product + SIMD\n";
+  res = mul::Measure(mat1, mat2, mul::mulOmpWinogradIntr);
+  std::cout << res.second << " ms" << std::endl;
+  assert(res.first == answ);
+
   std::cout << "Strassen\n";
   res = mul::Measure(mat1, mat2, mul::mulStrassen);
   std::cout << res.second << " ms" << std::endl;
@@ -58,6 +313,35 @@ int CompareWays() {
   std::cout << res.second << " ms" << std::endl;
   assert(res.first == answ);
 
+  std::cout << "Morton layout, cache-oblivious recursive\n";
+  res = mul::Measure(mat1, mat2, mul::mulMorton);
+  std::cout << res.second << " ms" << std::endl;
+  assert(res.first == answ);
+
+  std::cout << "Morton layout, Strassen\n";
+  res = mul::Measure(mat1, mat2, mul::mulMortonStrassen);
+  std::cout << res.second << " ms" << std::endl;
+  assert(res.first == answ);
+
+  std::cout << "Persistent pool engine, rows kernel + SIMD\n";
+  res = mul::Measure(mat1, mat2, mul::mulEngine);
+  std::cout << res.second << " ms" << std::endl;
+  assert(res.first == answ);
+
+  std::cout << "GEMM in-place, no transposed copy\n";
+  res = mul::Measure(mat1, mat2, mul::mulGemm);
+  std::cout << res.second << " ms" << std::endl;
+  assert(res.first == answ);
+
+  std::cout << "Semiring-generic kernel, (+, *)\n";
+  res = mul::Measure(mat1, mat2, mul::mulSemiring<mul::sr::PlusTimes>);
+  std::cout << res.second << " ms" << std::endl;
+  assert(res.first == answ);
+
+  CompareGemm(mat1, mat2, answ);
+  CompareGraphs(mat1.getRows());
+  ComparePowers(std::min<std::size_t>(mat1.getRows(), 256));
+
   return 0;
 }
 
@@ -65,18 +349,17 @@ template <std::forward_iterator It>
 int varSize(It beg, It end,
             std::pair<std::int32_t, std::int32_t> range_rnd = {0, 10}) {
   std::random_device dev{};
-  std::mt19937_64 gen(dev());
+  std::uint64_t seed = (std::uint64_t{dev()} << 32) | dev();
+  rnd::Uniform<std::int32_t> dist{range_rnd.first, range_rnd.second};
 
-  std::uniform_int_distribution<std::int32_t> dist(range_rnd.first,
-                                                   range_rnd.second);
-  auto &&rand_fill = [&dist, &gen](int, int) { return dist(gen); };
   struct Point {
     size_t size = 0;
     linal::ldbl time_ms = 0.0;
   };
 
-  std::for_each(beg, end, [rand_fill](auto size) {
-    mul::Mat mat1(size, size, rand_fill), mat2(size, size, rand_fill);
+  std::for_each(beg, end, [seed, dist](auto size) {
+    auto mat1 = rnd::randMatrix<std::int32_t>(size, size, seed, dist);
+    auto mat2 = rnd::randMatrix<std::int32_t>(size, size, seed + 1, dist);
 
     auto [answ, ms] = mul::Measure(mat1, mat2, mul::mulOMP16xTransp);
     assert(answ == mul::mulNaive(mat1, mat2));
@@ -12,6 +12,7 @@
 #include <omp.h>
 
 #include "matrix.hh"
+#include "morton.hh"
 #include "timer.hh"
 
 namespace mul {
@@ -66,7 +67,6 @@ Mat mulProm16xTransp(const Mat &lhs, const Mat &rhs) {
 
 Mat mulOMPNaive(const Mat &lhs, const Mat &rhs) {
   std::size_t tnum = omp_get_max_threads();
-  std::cout << "Threads " << tnum << std::endl;
 
   auto res = Mat{lhs.getRows(), rhs.getCols()};
   auto nrows = res.getRows();
@@ -233,6 +233,92 @@ Mat mulOmpProm8xTranspIntr(const Mat &lhs, const Mat &rhs) {
   return res;
 }
 
+// Winograd (1968) inner product: for every pair of k
+//   a0 * b0 + a1 * b1 = (a0 + b1) * (a1 + b0) - a0 * a1 - b0 * b1,
+// where a0 * a1 sums depend only on lhs row and b0 * b1 sums only on rhs
+// column, so they are precomputed once and each output element needs
+// half of the multiplications. Even and odd k are split into separate
+// matrices to keep vector loads contiguous.
+Mat mulOmpWinogradIntr(const Mat &lhs, const Mat &rhs) {
+  std::size_t tnum = omp_get_max_threads();
+
+  std::size_t res_c = rhs.getCols(), res_r = lhs.getRows(),
+              com_sz = lhs.getCols(), half = com_sz / 2,
+              end_k = half - half % 8, th_block = res_r / tnum + 1;
+
+  Mat lhs_e{res_r, half, [&lhs](auto i, auto k) { return lhs[i][2 * k]; }};
+  Mat lhs_o{res_r, half,
+            [&lhs](auto i, auto k) { return lhs[i][2 * k + 1]; }};
+  Mat rhs_e{res_c, half, [&rhs](auto j, auto k) { return rhs[2 * k][j]; }};
+  Mat rhs_o{res_c, half,
+            [&rhs](auto j, auto k) { return rhs[2 * k + 1][j]; }};
+  Mat res{res_r, res_c};
+
+  std::vector<std::int32_t> row_f(res_r), col_f(res_c);
+
+#pragma omp parallel num_threads(tnum)
+  {
+#pragma omp for
+    for (std::size_t i = 0; i < res_r; ++i)
+      for (std::size_t k = 0; k < half; ++k)
+        row_f[i] += lhs_e[i][k] * lhs_o[i][k];
+
+#pragma omp for
+    for (std::size_t j = 0; j < res_c; ++j)
+      for (std::size_t k = 0; k < half; ++k)
+        col_f[j] += rhs_e[j][k] * rhs_o[j][k];
+
+    std::size_t ti = omp_get_thread_num();
+
+    for (std::size_t i = ti * th_block;
+         i < std::min((ti + 1) * th_block, res_r); ++i)
+      for (std::size_t j = 0; j < res_c; ++j) {
+        const auto le_ptr = lhs_e[i], lo_ptr = lhs_o[i];
+        const auto re_ptr = rhs_e[j], ro_ptr = rhs_o[j];
+
+        std::size_t k = 0;
+        auto sum = _mm256_setzero_si256();
+        for (; k < end_k; k += 8) {
+          auto le_v = _mm256_loadu_si256(
+              reinterpret_cast<const __m256i *>(le_ptr + k));
+          auto lo_v = _mm256_loadu_si256(
+              reinterpret_cast<const __m256i *>(lo_ptr + k));
+          auto re_v = _mm256_loadu_si256(
+              reinterpret_cast<const __m256i *>(re_ptr + k));
+          auto ro_v = _mm256_loadu_si256(
+              reinterpret_cast<const __m256i *>(ro_ptr + k));
+
+          auto mul_v = _mm256_mullo_epi32(_mm256_add_epi32(le_v, ro_v),
+                                          _mm256_add_epi32(lo_v, re_v));
+
+          sum = _mm256_add_epi32(sum, mul_v);
+        }
+
+        auto swp128 = _mm256_permute2x128_si256(sum, sum, 1);
+        auto sum128 = _mm256_castsi256_si128(_mm256_add_epi32(sum, swp128));
+
+        auto swp64 = _mm_shuffle_epi32(sum128, _MM_SHUFFLE(1, 0, 3, 2));
+        auto sum64 = _mm_add_epi32(swp64, sum128);
+
+        auto swp32 = _mm_shuffle_epi32(sum64, _MM_SHUFFLE2(0, 1));
+        auto sum32 = _mm_add_epi32(swp32, sum64);
+
+        std::int32_t res_sum = _mm_cvtsi128_si32(sum32);
+
+        for (; k < half; ++k)
+          res_sum += (le_ptr[k] + ro_ptr[k]) * (lo_ptr[k] + re_ptr[k]);
+
+        res_sum -= row_f[i] + col_f[j];
+        if (com_sz % 2 != 0)
+          res_sum += lhs[i][com_sz - 1] * rhs[com_sz - 1][j];
+
+        res[i][j] = res_sum;
+      }
+  }
+
+  return res;
+}
+
 // интринсики и ускорение
 Mat mulStrassen(const Mat &lhs, const Mat &rhs) {
   std::size_t res_c = rhs.getCols(), res_r = lhs.getRows(),
@@ -408,6 +494,49 @@ Mat mulStrassenIntrinsicsOMP(const Mat &lhs, const Mat &rhs) {
   return res;
 }
 
+// Padded side of a Morton product, 0 if padding all three sizes to one
+// TILE * 2^k square would more than double the work: rectangular and just
+// over power of two shapes are left to the flat kernel
+std::size_t mortonSide(const Mat &lhs, const Mat &rhs) {
+  using MMat = linal::MortonMatrix<std::int32_t>;
+  std::size_t m = lhs.getRows(), k = lhs.getCols(), n = rhs.getCols();
+  auto side = MMat::sideFor(std::max({m, k, n}));
+
+  auto work = static_cast<linal::ldbl>(m) * k * n;
+  auto padded = static_cast<linal::ldbl>(side) * side * side;
+  return padded > 2 * work ? 0 : side;
+}
+
+Mat mulMorton(const Mat &lhs, const Mat &rhs) {
+  using MMat = linal::MortonMatrix<std::int32_t>;
+  auto side = mortonSide(lhs, rhs);
+  if (side == 0)
+    return mulOmpProm8xTranspIntr(lhs, rhs);
+
+  MMat lhs_m{lhs, side}, rhs_m{rhs, side};
+  MMat res_m{lhs.getRows(), rhs.getCols(), side};
+
+#pragma omp parallel
+#pragma omp single
+  mortonMulAdd(res_m.data(), lhs_m.data(), rhs_m.data(), side);
+
+  return res_m.toMatrix();
+}
+
+Mat mulMortonStrassen(const Mat &lhs, const Mat &rhs) {
+  using MMat = linal::MortonMatrix<std::int32_t>;
+  auto side = mortonSide(lhs, rhs);
+  if (side == 0)
+    return mulOmpProm8xTranspIntr(lhs, rhs);
+
+  MMat lhs_m{lhs, side}, rhs_m{rhs, side};
+  MMat res_m{lhs.getRows(), rhs.getCols(), side};
+
+  mortonStrassen(res_m.data(), lhs_m.data(), rhs_m.data(), side);
+
+  return res_m.toMatrix();
+}
+
 std::pair<Mat, linal::ldbl> Measure(const Mat &lhs, const Mat &rhs,
                                     MulFunc func) {
   timer::Timer timer;
@@ -418,6 +547,17 @@ std::pair<Mat, linal::ldbl> Measure(const Mat &lhs, const Mat &rhs,
 
   return {answ, res};
 }
+
+// 1, 2, 4, ... threads, always ending with all of them, so the full
+// machine is measured even if their number is not a power of two
+std::vector<int> threadCounts(int max_threads = omp_get_max_threads()) {
+  std::vector<int> res{};
+  for (int tnum = 1; tnum < max_threads; tnum *= 2)
+    res.push_back(tnum);
+  res.push_back(max_threads);
+
+  return res;
+}
 } // namespace mul
 
 #endif // __SEM7_OPENMP_8_MATMUL_MATMUL_HH__
@@ -0,0 +1,241 @@
+#ifndef __SEM7_OPENMP_8_MATMUL_MORTON_HH__
+#define __SEM7_OPENMP_8_MATMUL_MORTON_HH__
+
+#include <algorithm>
+#include <cstddef>
+#include <vector>
+
+#include <omp.h>
+
+#include "matrix.hh"
+
+namespace linal {
+
+// Square matrix stored as a Z-order (Morton) sequence of row-major tiles.
+// Any quadrant on any recursion level is a contiguous chunk of memory:
+// quadrants go in order 11, 12, 21, 22.
+template <typename T> class MortonMatrix final {
+public:
+  static constexpr std::size_t TILE = 32;
+  static constexpr std::size_t TILE_SZ = TILE * TILE;
+
+private:
+  std::vector<T> data_;
+  // padded side, always TILE * 2^k
+  std::size_t side_ = 0;
+  // logical sizes
+  std::size_t rows_ = 0, cols_ = 0;
+
+public:
+  MortonMatrix() = default;
+
+  MortonMatrix(std::size_t rows, std::size_t cols, std::size_t side = 0)
+      : side_(std::max(side, sideFor(std::max(rows, cols)))), rows_(rows),
+        cols_(cols) {
+    data_.resize(side_ * side_);
+  }
+
+  explicit MortonMatrix(const Matrix<T> &mat, std::size_t side = 0)
+      : MortonMatrix(mat.getRows(), mat.getCols(), side) {
+    auto tiles = side_ / TILE;
+
+#pragma omp parallel for
+    for (std::size_t ti = 0; ti < tiles; ++ti)
+      for (std::size_t tj = 0; tj < tiles; ++tj) {
+        auto tile = data_.data() + tileOffset(ti, tj);
+        for (std::size_t i = ti * TILE, ie = std::min(i + TILE, rows_);
+             i < ie; ++i) {
+          auto row = mat[i];
+          for (std::size_t j = tj * TILE, je = std::min(j + TILE, cols_);
+               j < je; ++j)
+            tile[(i % TILE) * TILE + j % TILE] = row[j];
+        }
+      }
+  }
+
+  Matrix<T> toMatrix() const {
+    Matrix<T> res{rows_, cols_};
+    auto tiles = side_ / TILE;
+
+#pragma omp parallel for
+    for (std::size_t ti = 0; ti < tiles; ++ti)
+      for (std::size_t tj = 0; tj < tiles; ++tj) {
+        auto tile = data_.data() + tileOffset(ti, tj);
+        for (std::size_t i = ti * TILE, ie = std::min(i + TILE, rows_);
+             i < ie; ++i) {
+          auto row = res[i];
+          for (std::size_t j = tj * TILE, je = std::min(j + TILE, cols_);
+               j < je; ++j)
+            row[j] = tile[(i % TILE) * TILE + j % TILE];
+        }
+      }
+
+    return res;
+  }
+
+  // Smallest admissible padded side for n x n matrix
+  static std::size_t sideFor(std::size_t n) {
+    std::size_t side = TILE;
+    while (side < n)
+      side *= 2;
+    return side;
+  }
+
+  // Offset of tile's first element: interleave tile row & col bits
+  static std::size_t tileOffset(std::size_t ti, std::size_t tj) {
+    std::size_t code = 0;
+    for (std::size_t bit = 0; (ti | tj) >> bit; ++bit)
+      code |= (((ti >> bit) & 1) << (2 * bit + 1)) |
+              (((tj >> bit) & 1) << (2 * bit));
+
+    return code * TILE_SZ;
+  }
+
+  static std::size_t index(std::size_t i, std::size_t j) {
+    return tileOffset(i / TILE, j / TILE) + (i % TILE) * TILE + j % TILE;
+  }
+
+  T &operator()(std::size_t i, std::size_t j) { return data_[index(i, j)]; }
+  const T &operator()(std::size_t i, std::size_t j) const {
+    return data_[index(i, j)];
+  }
+
+  T *data() { return data_.data(); }
+  const T *data() const { return data_.data(); }
+
+  std::size_t getSide() const { return side_; }
+  std::size_t getRows() const { return rows_; }
+  std::size_t getCols() const { return cols_; }
+};
+
+} // namespace linal
+
+namespace mul {
+
+// Sizes below this are multiplied conventionally inside Strassen recursion
+constexpr std::size_t MORTON_STRASSEN_CUTOFF = 128;
+// Subproblems below this are not spawned as separate tasks
+constexpr std::size_t MORTON_TASK_CUTOFF = 256;
+
+template <typename T>
+void mortonLeafMulAdd(T *__restrict c, const T *__restrict a,
+                      const T *__restrict b) {
+  constexpr auto TILE = linal::MortonMatrix<T>::TILE;
+
+  for (std::size_t i = 0; i < TILE; ++i) {
+    auto crow = c + i * TILE;
+    for (std::size_t k = 0; k < TILE; ++k) {
+      auto aik = a[i * TILE + k];
+      auto brow = b + k * TILE;
+      for (std::size_t j = 0; j < TILE; ++j)
+        crow[j] += aik * brow[j];
+    }
+  }
+}
+
+// c += a * b for n x n Morton blocks
+template <typename T>
+void mortonMulAdd(T *c, const T *a, const T *b, std::size_t n) {
+  if (n == linal::MortonMatrix<T>::TILE) {
+    mortonLeafMulAdd(c, a, b);
+    return;
+  }
+
+  auto h = n / 2, q = h * h;
+  const T *a11 = a, *a12 = a + q, *a21 = a + 2 * q, *a22 = a + 3 * q;
+  const T *b11 = b, *b12 = b + q, *b21 = b + 2 * q, *b22 = b + 3 * q;
+  T *c11 = c, *c12 = c + q, *c21 = c + 2 * q, *c22 = c + 3 * q;
+
+  // Both products into a quadrant stay in one task to avoid races on it
+#pragma omp task if (h >= MORTON_TASK_CUTOFF)
+  mortonMulAdd(c11, a11, b11, h), mortonMulAdd(c11, a12, b21, h);
+#pragma omp task if (h >= MORTON_TASK_CUTOFF)
+  mortonMulAdd(c12, a11, b12, h), mortonMulAdd(c12, a12, b22, h);
+#pragma omp task if (h >= MORTON_TASK_CUTOFF)
+  mortonMulAdd(c21, a21, b11, h), mortonMulAdd(c21, a22, b21, h);
+#pragma omp task if (h >= MORTON_TASK_CUTOFF)
+  mortonMulAdd(c22, a21, b12, h), mortonMulAdd(c22, a22, b22, h);
+#pragma omp taskwait
+}
+
+template <typename T>
+void mortonAdd(T *dst, const T *lhs, const T *rhs, std::size_t sz) {
+  for (std::size_t i = 0; i < sz; ++i)
+    dst[i] = lhs[i] + rhs[i];
+}
+
+template <typename T>
+void mortonSub(T *dst, const T *lhs, const T *rhs, std::size_t sz) {
+  for (std::size_t i = 0; i < sz; ++i)
+    dst[i] = lhs[i] - rhs[i];
+}
+
+template <typename T> void mortonAcc(T *dst, const T *src, std::size_t sz) {
+  for (std::size_t i = 0; i < sz; ++i)
+    dst[i] += src[i];
+}
+
+template <typename T> void mortonDec(T *dst, const T *src, std::size_t sz) {
+  for (std::size_t i = 0; i < sz; ++i)
+    dst[i] -= src[i];
+}
+
+// c = a * b for n x n Morton blocks. Quadrant sums are plain linear loops
+// as every quadrant is contiguous. Each product is accumulated straight
+// into c, so a level needs only three temporary quadrants.
+template <typename T>
+void mortonStrassen(T *c, const T *a, const T *b, std::size_t n) {
+  if (n <= MORTON_STRASSEN_CUTOFF) {
+    std::fill(c, c + n * n, T{});
+    mortonMulAdd(c, a, b, n);
+    return;
+  }
+
+  auto h = n / 2, q = h * h;
+  const T *a11 = a, *a12 = a + q, *a21 = a + 2 * q, *a22 = a + 3 * q;
+  const T *b11 = b, *b12 = b + q, *b21 = b + 2 * q, *b22 = b + 3 * q;
+  T *c11 = c, *c12 = c + q, *c21 = c + 2 * q, *c22 = c + 3 * q;
+
+  std::fill(c, c + n * n, T{});
+  std::vector<T> buf(3 * q);
+  T *tl = buf.data(), *tr = tl + q, *m = tr + q;
+
+  // M1 = (A11 + A22)(B11 + B22)
+  mortonAdd(tl, a11, a22, q), mortonAdd(tr, b11, b22, q);
+  mortonStrassen(m, tl, tr, h);
+  mortonAcc(c11, m, q), mortonAcc(c22, m, q);
+
+  // M2 = (A21 + A22) B11
+  mortonAdd(tl, a21, a22, q);
+  mortonStrassen(m, tl, b11, h);
+  mortonAcc(c21, m, q), mortonDec(c22, m, q);
+
+  // M3 = A11 (B12 - B22)
+  mortonSub(tr, b12, b22, q);
+  mortonStrassen(m, a11, tr, h);
+  mortonAcc(c12, m, q), mortonAcc(c22, m, q);
+
+  // M4 = A22 (B21 - B11)
+  mortonSub(tr, b21, b11, q);
+  mortonStrassen(m, a22, tr, h);
+  mortonAcc(c11, m, q), mortonAcc(c21, m, q);
+
+  // M5 = (A11 + A12) B22
+  mortonAdd(tl, a11, a12, q);
+  mortonStrassen(m, tl, b22, h);
+  mortonDec(c11, m, q), mortonAcc(c12, m, q);
+
+  // M6 = (A21 - A11)(B11 + B12)
+  mortonSub(tl, a21, a11, q), mortonAdd(tr, b11, b12, q);
+  mortonStrassen(m, tl, tr, h);
+  mortonAcc(c22, m, q);
+
+  // M7 = (A12 - A22)(B21 + B22)
+  mortonSub(tl, a12, a22, q), mortonAdd(tr, b21, b22, q);
+  mortonStrassen(m, tl, tr, h);
+  mortonAcc(c11, m, q);
+}
+
+} // namespace mul
+
+#endif // __SEM7_OPENMP_8_MATMUL_MORTON_HH__
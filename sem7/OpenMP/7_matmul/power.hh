@@ -0,0 +1,239 @@
+#ifndef __SEM7_OPENMP_8_MATMUL_POWER_HH__
+#define __SEM7_OPENMP_8_MATMUL_POWER_HH__
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include <immintrin.h>
+#include <omp.h>
+
+#include "gemm.hh"
+
+namespace mul {
+
+// acc += val * src over 64-bit accumulators, src values are nonnegative
+void axpyWideIntr(std::uint64_t *acc, std::uint32_t val,
+                  const std::int32_t *src, std::size_t size) {
+  std::size_t j = 0, end_j = size - size % 4;
+  auto val_v = _mm256_set1_epi64x(val);
+
+  for (; j < end_j; j += 4) {
+    auto acc_p = reinterpret_cast<__m256i *>(acc + j);
+    auto src_v = _mm256_cvtepu32_epi64(
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + j)));
+    auto acc_v = _mm256_loadu_si256(acc_p);
+
+    acc_v = _mm256_add_epi64(acc_v, _mm256_mul_epu32(val_v, src_v));
+    _mm256_storeu_si256(acc_p, acc_v);
+  }
+
+  for (; j < size; ++j)
+    acc[j] += std::uint64_t{val} * static_cast<std::uint32_t>(src[j]);
+}
+
+// Accumulators are kept below 2^64 without division: acc = hi * 2^32 + lo
+// is folded into lo + hi * (2^32 mod mod), which is congruent to it modulo
+// mod and, as hi < 2^32 and mod <= 2^31, smaller than 2^63. For mod a power
+// of two the factor is 0 and a fold is a mask.
+std::uint64_t modFoldFactor(std::uint32_t mod) {
+  return (std::uint64_t{1} << 32) % mod;
+}
+
+std::uint64_t foldMod(std::uint64_t acc, std::uint64_t factor) {
+  return (acc & 0xFFFF'FFFF) + (acc >> 32) * factor;
+}
+
+// acc[j] = foldMod(acc[j], factor)
+void foldModIntr(std::uint64_t *acc, std::uint64_t factor, std::size_t size) {
+  std::size_t j = 0, end_j = size - size % 4;
+  auto mask_v = _mm256_set1_epi64x(0xFFFF'FFFF);
+  auto factor_v = _mm256_set1_epi64x(factor);
+
+  for (; j < end_j; j += 4) {
+    auto acc_p = reinterpret_cast<__m256i *>(acc + j);
+    auto acc_v = _mm256_loadu_si256(acc_p);
+    auto hi_v = _mm256_mul_epu32(_mm256_srli_epi64(acc_v, 32), factor_v);
+
+    acc_v = _mm256_add_epi64(_mm256_and_si256(acc_v, mask_v), hi_v);
+    _mm256_storeu_si256(acc_p, acc_v);
+  }
+
+  for (; j < size; ++j)
+    acc[j] = foldMod(acc[j], factor);
+}
+
+// Amount of products < mod^2 that can be added to a folded 64-bit
+// accumulator before it has to be folded again. Near 2^31 this is about
+// 3, but a fold costs no more than one axpy step.
+// Powers of two skip all this: int32 arithmetic wraps modulo 2^32, which
+// they divide, so the wrapping kernels plus a mask are exact.
+bool isPow2(std::uint32_t mod) { return (mod & (mod - 1)) == 0; }
+
+std::size_t modReduceStep(std::uint32_t mod) {
+  std::uint64_t max_term = std::uint64_t{mod - 1} * (mod - 1);
+  if (max_term == 0)
+    return std::numeric_limits<std::size_t>::max();
+
+  auto max_folded = foldMod(std::numeric_limits<std::uint64_t>::max(),
+                            modFoldFactor(mod));
+  return std::max<std::uint64_t>(
+      (std::numeric_limits<std::uint64_t>::max() - max_folded) / max_term, 1);
+}
+
+// Copy of m with elements brought to [0, mod)
+Mat reduceMod(const Mat &m, std::uint32_t mod) {
+  return Mat{m.getRows(), m.getCols(), [&m, mod](auto i, auto j) {
+               auto val = static_cast<std::int64_t>(m[i][j]) % mod;
+               return static_cast<std::int32_t>(val < 0 ? val + mod : val);
+             }};
+}
+
+// res = lhs * rhs mod `mod`, operands must be reduced to [0, mod).
+// Products are summed in 64 bits and folded only once the next batch of
+// terms could overflow the accumulator; % is taken once per element.
+void mulModInto(const Mat &lhs, const Mat &rhs, Mat &res,
+                std::uint32_t mod) {
+  if (isPow2(mod)) {
+    std::int32_t mask = mod - 1;
+    gemm(Op::N, Op::N, 1, lhs, rhs, 0, res,
+         [mask](std::int32_t val, std::size_t, std::size_t) {
+           return val & mask;
+         });
+    return;
+  }
+
+  std::size_t res_r = res.getRows(), res_c = res.getCols(),
+              com_sz = lhs.getCols(), step = modReduceStep(mod);
+  auto factor = modFoldFactor(mod);
+
+#pragma omp parallel
+  {
+    std::vector<std::uint64_t> acc(res_c);
+
+#pragma omp for schedule(static)
+    for (std::size_t i = 0; i < res_r; ++i) {
+      std::fill(acc.begin(), acc.end(), 0);
+      const auto lptr = lhs[i];
+
+      for (std::size_t k = 0; k < com_sz; ++k) {
+        axpyWideIntr(acc.data(), lptr[k], rhs[k], res_c);
+
+        if ((k + 1) % step == 0)
+          foldModIntr(acc.data(), factor, res_c);
+      }
+
+      auto rptr = res[i];
+      for (std::size_t j = 0; j < res_c; ++j)
+        rptr[j] = static_cast<std::int32_t>(acc[j] % mod);
+    }
+  }
+}
+
+// m^k by binary exponentiation. Result, base and one scratch matrix are
+// allocated once and ping-ponged; each step is an in-place product that
+// needs no transposed copy. With mod != 0 arithmetic is done modulo mod
+// (mod <= 2^31), otherwise it wraps as in the other int32 kernels.
+Mat power(const Mat &m, std::uint64_t k, std::uint32_t mod = 0) {
+  if (m.getRows() != m.getCols())
+    throw std::invalid_argument{"Matrix must be square"};
+  if (mod > (std::uint32_t{1} << 31))
+    throw std::invalid_argument{"Modulus must not exceed 2^31"};
+
+  auto size = m.getRows();
+  auto base = mod != 0 ? reduceMod(m, mod) : m;
+
+  if (k == 0) {
+    auto id = Mat::Identity(size);
+    if (mod == 1)
+      id.walker([](auto, auto) { return 0; });
+    return id;
+  }
+
+  auto mult = [mod](const Mat &lhs, const Mat &rhs, Mat &res) {
+    if (mod != 0)
+      mulModInto(lhs, rhs, res, mod);
+    else
+      gemm(Op::N, Op::N, 1, lhs, rhs, 0, res);
+  };
+
+  Mat res{size, size}, tmp{size, size};
+  bool res_is_id = true;
+
+  for (;;) {
+    if (k & 1) {
+      if (res_is_id)
+        res = base, res_is_id = false;
+      else {
+        mult(res, base, tmp);
+        std::swap(res, tmp);
+      }
+    }
+
+    k >>= 1;
+    if (k == 0)
+      return res;
+
+    mult(base, base, tmp);
+    std::swap(base, tmp);
+  }
+}
+
+// m^k * vec by k matrix-vector products on two ping-pong vectors:
+// O(k n^2) instead of O(n^3 log k), for power iteration and small k.
+std::vector<std::int32_t> powerApply(const Mat &m,
+                                     std::vector<std::int32_t> vec,
+                                     std::uint64_t k, std::uint32_t mod = 0) {
+  if (m.getRows() != m.getCols() || m.getCols() != vec.size())
+    throw std::invalid_argument{"Incompatible matrix and vector sizes"};
+
+  auto size = vec.size();
+  std::vector<std::int32_t> nxt(size);
+  Mat red{};
+
+  if (mod != 0) {
+    red = reduceMod(m, mod);
+    for (auto &&elem : vec) {
+      auto val = static_cast<std::int64_t>(elem) % mod;
+      elem = static_cast<std::int32_t>(val < 0 ? val + mod : val);
+    }
+  }
+
+  std::size_t step = 0;
+  std::uint64_t factor = 0;
+  if (mod != 0)
+    step = modReduceStep(mod), factor = modFoldFactor(mod);
+
+  for (std::uint64_t iter = 0; iter < k; ++iter) {
+#pragma omp parallel for schedule(static)
+    for (std::size_t i = 0; i < size; ++i) {
+      if (mod == 0 || isPow2(mod)) {
+        auto dot = dotIntr(mod == 0 ? m[i] : red[i], vec.data(), size);
+        nxt[i] = mod == 0 ? dot : dot & static_cast<std::int32_t>(mod - 1);
+        continue;
+      }
+
+      const auto mptr = red[i];
+      std::uint64_t acc = 0;
+      for (std::size_t j = 0; j < size; ++j) {
+        acc += std::uint64_t{static_cast<std::uint32_t>(mptr[j])} *
+               static_cast<std::uint32_t>(vec[j]);
+        if ((j + 1) % step == 0)
+          acc = foldMod(acc, factor);
+      }
+      nxt[i] = static_cast<std::int32_t>(acc % mod);
+    }
+
+    std::swap(vec, nxt);
+  }
+
+  return vec;
+}
+
+} // namespace mul
+
+#endif // __SEM7_OPENMP_8_MATMUL_POWER_HH__
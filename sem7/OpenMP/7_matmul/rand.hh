@@ -0,0 +1,209 @@
+#ifndef __SEM7_OPENMP_8_MATMUL_RAND_HH__
+#define __SEM7_OPENMP_8_MATMUL_RAND_HH__
+
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <numbers>
+#include <type_traits>
+#include <vector>
+
+#include <immintrin.h>
+#include <omp.h>
+
+#include "matrix.hh"
+
+// Counter-based random generation (Philox4x32-10, Salmon et al. 2011).
+// Value at (i, j) is a pure function of (seed, stream, i, j), so a matrix
+// is filled row-parallel and is bitwise identical for any thread count.
+namespace rnd {
+
+constexpr std::uint32_t PHILOX_M0 = 0xD2511F53;
+constexpr std::uint32_t PHILOX_M1 = 0xCD9E8D57;
+constexpr std::uint32_t PHILOX_W0 = 0x9E3779B9;
+constexpr std::uint32_t PHILOX_W1 = 0xBB67AE85;
+constexpr std::size_t PHILOX_ROUNDS = 10;
+
+using Block = std::array<std::uint32_t, 4>;
+
+Block philox(Block ctr, std::uint64_t seed) {
+  std::uint32_t k0 = seed, k1 = seed >> 32;
+
+  for (std::size_t r = 0; r < PHILOX_ROUNDS; ++r) {
+    if (r != 0)
+      k0 += PHILOX_W0, k1 += PHILOX_W1;
+
+    std::uint64_t p0 = std::uint64_t{PHILOX_M0} * ctr[0];
+    std::uint64_t p1 = std::uint64_t{PHILOX_M1} * ctr[2];
+
+    ctr = {static_cast<std::uint32_t>(p1 >> 32) ^ ctr[1] ^ k0,
+           static_cast<std::uint32_t>(p1),
+           static_cast<std::uint32_t>(p0 >> 32) ^ ctr[3] ^ k1,
+           static_cast<std::uint32_t>(p0)};
+  }
+
+  return ctr;
+}
+
+// Lane-wise 32x32 -> 64 multiply of 8 lanes split into high & low words
+void mulhilo8(__m256i val, __m256i mul, __m256i &hi, __m256i &lo) {
+  auto even = _mm256_mul_epu32(val, mul);
+  auto odd = _mm256_mul_epu32(_mm256_srli_epi64(val, 32), mul);
+
+  lo = _mm256_blend_epi32(even, _mm256_slli_epi64(odd, 32), 0b10101010);
+  hi = _mm256_blend_epi32(_mm256_srli_epi64(even, 32), odd, 0b10101010);
+}
+
+// Write 4 * nblocks raw words of blocks {b, row, stream, 0}, b < nblocks.
+// Eight blocks go through AVX2 rounds at once, the rest is scalar.
+void philoxRow(std::uint64_t seed, std::uint32_t stream, std::uint32_t row,
+               std::uint32_t *out, std::size_t nblocks) {
+  std::size_t b = 0, end_b = nblocks - nblocks % 8;
+  auto m0 = _mm256_set1_epi32(PHILOX_M0), m1 = _mm256_set1_epi32(PHILOX_M1);
+  auto lanes = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+
+  for (; b < end_b; b += 8) {
+    auto x0 = _mm256_add_epi32(_mm256_set1_epi32(b), lanes);
+    auto x1 = _mm256_set1_epi32(row);
+    auto x2 = _mm256_set1_epi32(stream);
+    auto x3 = _mm256_setzero_si256();
+    std::uint32_t k0 = seed, k1 = seed >> 32;
+
+    for (std::size_t r = 0; r < PHILOX_ROUNDS; ++r) {
+      if (r != 0)
+        k0 += PHILOX_W0, k1 += PHILOX_W1;
+
+      __m256i hi0, lo0, hi1, lo1;
+      mulhilo8(x0, m0, hi0, lo0);
+      mulhilo8(x2, m1, hi1, lo1);
+
+      x0 = _mm256_xor_si256(_mm256_xor_si256(hi1, x1), _mm256_set1_epi32(k0));
+      x1 = lo1;
+      x2 = _mm256_xor_si256(_mm256_xor_si256(hi0, x3), _mm256_set1_epi32(k1));
+      x3 = lo0;
+    }
+
+    alignas(32) std::uint32_t words[4][8];
+    _mm256_store_si256(reinterpret_cast<__m256i *>(words[0]), x0);
+    _mm256_store_si256(reinterpret_cast<__m256i *>(words[1]), x1);
+    _mm256_store_si256(reinterpret_cast<__m256i *>(words[2]), x2);
+    _mm256_store_si256(reinterpret_cast<__m256i *>(words[3]), x3);
+
+    for (std::size_t l = 0; l < 8; ++l)
+      for (std::size_t w = 0; w < 4; ++w)
+        out[4 * (b + l) + w] = words[w][l];
+  }
+
+  for (; b < nblocks; ++b) {
+    auto blk = philox({static_cast<std::uint32_t>(b), row, stream, 0}, seed);
+    for (std::size_t w = 0; w < 4; ++w)
+      out[4 * b + w] = blk[w];
+  }
+}
+
+// Map raw word to (0, 1)
+double toUnit(std::uint32_t word) {
+  return (word + 0.5) * (1.0 / 4294967296.0);
+}
+
+// Distributions fill one row of n values from (seed, row); buf is scratch
+// space owned by the calling thread.
+template <typename T> struct Uniform {
+  T lo, hi;
+
+  void fillRow(std::uint64_t seed, std::uint32_t row, T *dst, std::size_t n,
+               std::vector<std::uint32_t> &buf,
+               std::uint32_t stream = 0) const {
+    buf.resize((n + 3) / 4 * 4);
+    philoxRow(seed, stream, row, buf.data(), buf.size() / 4);
+
+    if constexpr (std::is_integral_v<T>) {
+      // multiply-shift range reduction, hi is inclusive
+      std::uint64_t range =
+          static_cast<std::uint64_t>(static_cast<std::int64_t>(hi) - lo) + 1;
+      for (std::size_t j = 0; j < n; ++j)
+        dst[j] = static_cast<T>(lo + static_cast<std::int64_t>(
+                                         (buf[j] * range) >> 32));
+    } else
+      for (std::size_t j = 0; j < n; ++j)
+        dst[j] = static_cast<T>(lo + (hi - lo) * toUnit(buf[j]));
+  }
+};
+
+// Box-Muller over word pairs (2m, 2m + 1)
+template <typename T> struct Normal {
+  double mean = 0, stddev = 1;
+
+  void fillRow(std::uint64_t seed, std::uint32_t row, T *dst, std::size_t n,
+               std::vector<std::uint32_t> &buf,
+               std::uint32_t stream = 0) const {
+    buf.resize((n + 3) / 4 * 4);
+    philoxRow(seed, stream, row, buf.data(), buf.size() / 4);
+
+    for (std::size_t j = 0; j < n; j += 2) {
+      auto rad = stddev * std::sqrt(-2 * std::log(toUnit(buf[j])));
+      auto ang = 2 * std::numbers::pi * toUnit(buf[j + 1]);
+
+      store(dst[j], mean + rad * std::cos(ang));
+      if (j + 1 < n)
+        store(dst[j + 1], mean + rad * std::sin(ang));
+    }
+  }
+
+private:
+  static void store(T &dst, double val) {
+    if constexpr (std::is_integral_v<T>)
+      dst = static_cast<T>(std::lround(val));
+    else
+      dst = static_cast<T>(val);
+  }
+};
+
+// Values of Dist kept with given probability, zeros elsewhere. The mask
+// comes from a separate stream so it does not correlate with values.
+template <typename T, typename Dist> struct Sparse {
+  double density;
+  Dist dist;
+
+  void fillRow(std::uint64_t seed, std::uint32_t row, T *dst, std::size_t n,
+               std::vector<std::uint32_t> &buf,
+               std::uint32_t stream = 0) const {
+    dist.fillRow(seed, row, dst, n, buf, stream);
+
+    buf.resize((n + 3) / 4 * 4);
+    philoxRow(seed, stream + 1, row, buf.data(), buf.size() / 4);
+
+    auto thres = static_cast<std::uint64_t>(density * 4294967296.0);
+    for (std::size_t j = 0; j < n; ++j)
+      if (buf[j] >= thres)
+        dst[j] = T{};
+  }
+};
+
+template <typename T, typename Dist>
+void fill(linal::Matrix<T> &mat, std::uint64_t seed, const Dist &dist) {
+  std::size_t nrows = mat.getRows(), ncols = mat.getCols();
+
+#pragma omp parallel
+  {
+    std::vector<std::uint32_t> buf{};
+
+#pragma omp for schedule(static)
+    for (std::size_t i = 0; i < nrows; ++i)
+      dist.fillRow(seed, static_cast<std::uint32_t>(i), mat[i], ncols, buf);
+  }
+}
+
+template <typename T, typename Dist>
+linal::Matrix<T> randMatrix(std::size_t rows, std::size_t cols,
+                            std::uint64_t seed, const Dist &dist) {
+  linal::Matrix<T> mat{rows, cols};
+  fill(mat, seed, dist);
+
+  return mat;
+}
+
+} // namespace rnd
+
+#endif // __SEM7_OPENMP_8_MATMUL_RAND_HH__
@@ -0,0 +1,267 @@
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <string_view>
+#include <vector>
+
+#include <immintrin.h>
+#include <omp.h>
+#include <unistd.h>
+
+#include "gemm.hh"
+#include "matmul.hh"
+#include "rand.hh"
+
+// Roofline reference points for the matmul kernels: STREAM-style
+// bandwidth per working set size, peak SIMD throughput, and achieved
+// rate of every kernel against min(peak, intensity * bandwidth).
+
+constexpr std::size_t REPEATS = 5;
+
+struct Level {
+  std::string_view name;
+  // total size of the three STREAM arrays
+  std::size_t bytes;
+};
+
+// Cache size reported by the host, or fallback if it reports none
+std::size_t cacheSize(int name, std::size_t fallback) {
+  auto size = sysconf(name);
+  return size > 0 ? static_cast<std::size_t>(size) : fallback;
+}
+
+// Working sets for tnum threads sitting well inside each level of this
+// host: half of every thread's private L1 and L2, half of the shared L3,
+// and DRAM several times past the last level. Levels no larger than the
+// one before them are dropped.
+std::vector<Level> hostLevels(int tnum) {
+  auto l1 = cacheSize(_SC_LEVEL1_DCACHE_SIZE, 32 << 10),
+       l2 = cacheSize(_SC_LEVEL2_CACHE_SIZE, 1 << 20),
+       l3 = cacheSize(_SC_LEVEL3_CACHE_SIZE, 0);
+
+  std::vector<Level> res{{"L1", l1 / 2 * tnum}};
+  for (auto &&lvl : {Level{"L2", l2 / 2 * tnum}, Level{"L3", l3 / 2},
+                     Level{"DRAM", 4 * std::max(l3, l2 * tnum)}})
+    if (lvl.bytes > res.back().bytes)
+      res.push_back(lvl);
+
+  return res;
+}
+
+struct Stream {
+  double copy = 0, scale = 0, add = 0, triad = 0;
+};
+
+// Best of REPEATS runs. All passes of a run share one parallel region and
+// kernels split their loop with "omp for nowait": static schedule gives a
+// thread the same chunk in every pass, so passes need no barrier and small
+// levels measure bandwidth, not fork/join.
+template <typename Kernel>
+double bestGBs(Kernel kernel, std::size_t bytes_per_pass,
+               std::size_t passes) {
+  double best = 0;
+  for (std::size_t rep = 0; rep < REPEATS; ++rep) {
+    auto tic = omp_get_wtime();
+#pragma omp parallel
+    for (std::size_t p = 0; p < passes; ++p)
+      kernel();
+    auto sec = omp_get_wtime() - tic;
+
+    best = std::max(best, bytes_per_pass * passes / sec / 1e9);
+  }
+  return best;
+}
+
+Stream measureStream(std::size_t bytes) {
+  std::size_t size = bytes / (3 * sizeof(double));
+  std::vector<double> a(size), b(size), c(size);
+  double q = 3.0;
+
+#pragma omp parallel for schedule(static)
+  for (std::size_t i = 0; i < size; ++i)
+    a[i] = 1.0, b[i] = 2.0, c[i] = 0.0;
+
+  // ~1 GB of traffic per measurement
+  auto passes = std::max<std::size_t>((1 << 30) / bytes, 1);
+  auto ap = a.data(), bp = b.data(), cp = c.data();
+  Stream res{};
+
+  res.copy = bestGBs(
+      [=] {
+#pragma omp for schedule(static) nowait
+        for (std::size_t i = 0; i < size; ++i)
+          cp[i] = ap[i];
+      },
+      2 * sizeof(double) * size, passes);
+
+  res.scale = bestGBs(
+      [=] {
+#pragma omp for schedule(static) nowait
+        for (std::size_t i = 0; i < size; ++i)
+          bp[i] = q * cp[i];
+      },
+      2 * sizeof(double) * size, passes);
+
+  res.add = bestGBs(
+      [=] {
+#pragma omp for schedule(static) nowait
+        for (std::size_t i = 0; i < size; ++i)
+          cp[i] = ap[i] + bp[i];
+      },
+      3 * sizeof(double) * size, passes);
+
+  res.triad = bestGBs(
+      [=] {
+#pragma omp for schedule(static) nowait
+        for (std::size_t i = 0; i < size; ++i)
+          ap[i] = bp[i] + q * cp[i];
+      },
+      3 * sizeof(double) * size, passes);
+
+  return res;
+}
+
+constexpr std::size_t PEAK_ITERS = 1 << 24;
+constexpr std::size_t CHAINS = 8;
+
+// keeps peak loops from being optimized out
+volatile double peak_sink = 0;
+
+// mullo + add on CHAINS independent vectors: 16 int32 ops per step each
+double peakInt32() {
+  double best = 0;
+  for (std::size_t rep = 0; rep < REPEATS; ++rep) {
+    std::int32_t sink = 0;
+    auto tic = omp_get_wtime();
+
+#pragma omp parallel reduction(+ : sink)
+    {
+      __m256i acc[CHAINS];
+      for (std::size_t c = 0; c < CHAINS; ++c)
+        acc[c] = _mm256_set1_epi32(c + omp_get_thread_num());
+      auto mul_v = _mm256_set1_epi32(3), add_v = _mm256_set1_epi32(1);
+
+      for (std::size_t it = 0; it < PEAK_ITERS; ++it)
+        for (auto &&vec : acc)
+          vec = _mm256_add_epi32(_mm256_mullo_epi32(vec, mul_v), add_v);
+
+      for (auto &&vec : acc)
+        sink += _mm256_extract_epi32(vec, 0);
+    }
+
+    auto sec = omp_get_wtime() - tic;
+    auto ops = 16.0 * CHAINS * PEAK_ITERS * omp_get_max_threads();
+    best = std::max(best, ops / sec / 1e9);
+    peak_sink = sink;
+  }
+  return best;
+}
+
+// FMA on CHAINS independent vectors: 16 flops per step each
+double peakFloat() {
+  double best = 0;
+  for (std::size_t rep = 0; rep < REPEATS; ++rep) {
+    float sink = 0;
+    auto tic = omp_get_wtime();
+
+#pragma omp parallel reduction(+ : sink)
+    {
+      __m256 acc[CHAINS];
+      for (std::size_t c = 0; c < CHAINS; ++c)
+        acc[c] = _mm256_set1_ps(c + omp_get_thread_num());
+      auto mul_v = _mm256_set1_ps(0.999f), add_v = _mm256_set1_ps(1e-3f);
+
+      for (std::size_t it = 0; it < PEAK_ITERS; ++it)
+        for (auto &&vec : acc)
+          vec = _mm256_fmadd_ps(vec, mul_v, add_v);
+
+      for (auto &&vec : acc)
+        sink += _mm256_cvtss_f32(vec);
+    }
+
+    auto sec = omp_get_wtime() - tic;
+    auto ops = 16.0 * CHAINS * PEAK_ITERS * omp_get_max_threads();
+    best = std::max(best, ops / sec / 1e9);
+    peak_sink = sink;
+  }
+  return best;
+}
+
+struct Kernel {
+  std::string_view name;
+  mul::MulFunc func;
+};
+
+const auto KERNELS = std::to_array<Kernel>({
+    {"omp16xTransp", mul::mulOMP16xTransp},
+    {"ompProm8xTranspIntr", mul::mulOmpProm8xTranspIntr},
+    {"ompWinogradIntr", mul::mulOmpWinogradIntr},
+    {"strassenIntrinsicsOMP", mul::mulStrassenIntrinsicsOMP},
+    {"morton", mul::mulMorton},
+    {"gemm", mul::mulGemm},
+});
+
+int main(int ac, char **av) {
+  std::size_t size = ac > 1 ? std::atoll(av[1]) : 512;
+  auto threads = mul::threadCounts();
+
+  rnd::Uniform<std::int32_t> dist{-10, 10};
+  auto lhs = rnd::randMatrix<std::int32_t>(size, size, 1, dist);
+  auto rhs = rnd::randMatrix<std::int32_t>(size, size, 2, dist);
+
+  // Nominal 2 n^3 ops over compulsory traffic of three n x n int32 matrices
+  double ops = 2.0 * size * size * size;
+  double intensity = ops / (3.0 * size * size * sizeof(std::int32_t));
+
+  std::cout << "# threads, level, bytes, copy GB/s, scale GB/s, add GB/s, "
+               "triad GB/s"
+            << std::endl;
+  std::vector<double> dram_bw{};
+  for (auto tnum : threads) {
+    omp_set_num_threads(tnum);
+    for (auto &&lvl : hostLevels(tnum)) {
+      auto st = measureStream(lvl.bytes);
+      std::cout << tnum << ", " << lvl.name << ", " << lvl.bytes << ", "
+                << st.copy << ", " << st.scale << ", " << st.add << ", "
+                << st.triad << std::endl;
+      if (lvl.name == "DRAM")
+        dram_bw.push_back(st.triad);
+    }
+  }
+
+  std::cout << "# threads, int32 GOP/s, float GFLOP/s" << std::endl;
+  std::vector<double> peak{};
+  for (auto tnum : threads) {
+    omp_set_num_threads(tnum);
+    auto int_peak = peakInt32();
+    std::cout << tnum << ", " << int_peak << ", " << peakFloat()
+              << std::endl;
+    peak.push_back(int_peak);
+  }
+
+  std::cout << "# threads, kernel, n, ms, GOP/s, op/B, roof GOP/s, % of roof"
+            << std::endl;
+  for (std::size_t t = 0; t < threads.size(); ++t) {
+    auto tnum = threads[t];
+    omp_set_num_threads(tnum);
+    auto roof = std::min(peak[t], intensity * dram_bw[t]);
+
+    for (auto &&kern : KERNELS) {
+      linal::ldbl best_ms = -1;
+      for (std::size_t rep = 0; rep < REPEATS; ++rep) {
+        auto ms = mul::Measure(lhs, rhs, kern.func).second;
+        best_ms = best_ms < 0 ? ms : std::min(best_ms, ms);
+      }
+
+      auto gops = ops / (best_ms / 1e3) / 1e9;
+      std::cout << tnum << ", " << kern.name << ", " << size << ", "
+                << best_ms << ", " << gops << ", " << intensity << ", "
+                << roof << ", " << 100 * gops / roof << std::endl;
+    }
+  }
+
+  return 0;
+}
@@ -0,0 +1,146 @@
+#ifndef __SEM7_OPENMP_8_MATMUL_SEMIRING_HH__
+#define __SEM7_OPENMP_8_MATMUL_SEMIRING_HH__
+
+#include <algorithm>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+
+#include <immintrin.h>
+#include <omp.h>
+
+#include "matmul.hh"
+
+namespace mul {
+
+// Semirings for mulSemiring. Each one defines element type, additive
+// identity ZERO, multiplicative identity ONE, add and mul. A semiring may
+// also provide vectorized dot(lhs, rhs, size), it is used when present.
+namespace sr {
+struct PlusTimes {
+  using type = std::int32_t;
+  static constexpr type ZERO = 0;
+  static constexpr type ONE = 1;
+
+  static type add(type lhs, type rhs) { return lhs + rhs; }
+  static type mul(type lhs, type rhs) { return lhs * rhs; }
+};
+
+// Tropical semiring for shortest paths. INF is "no edge"; it is chosen so
+// that INF + INF does not overflow, sums above INF are clamped back to it.
+struct MinPlus {
+  using type = std::int32_t;
+  static constexpr type INF = std::numeric_limits<type>::max() / 2;
+  static constexpr type ZERO = INF;
+  static constexpr type ONE = 0;
+
+  static type add(type lhs, type rhs) { return std::min(lhs, rhs); }
+  static type mul(type lhs, type rhs) { return std::min(lhs + rhs, INF); }
+
+  static type dot(const type *lptr, const type *rptr, std::size_t size) {
+    std::size_t k = 0, end_k = size - size % 8;
+    auto acc = _mm256_set1_epi32(INF);
+
+    for (; k < end_k; k += 8) {
+      auto lhs_v =
+          _mm256_loadu_si256(reinterpret_cast<const __m256i *>(lptr + k));
+      auto rhs_v =
+          _mm256_loadu_si256(reinterpret_cast<const __m256i *>(rptr + k));
+
+      acc = _mm256_min_epi32(acc, _mm256_add_epi32(lhs_v, rhs_v));
+    }
+
+    auto swp128 = _mm256_permute2x128_si256(acc, acc, 1);
+    auto min128 = _mm256_castsi256_si128(_mm256_min_epi32(acc, swp128));
+
+    auto swp64 = _mm_shuffle_epi32(min128, _MM_SHUFFLE(1, 0, 3, 2));
+    auto min64 = _mm_min_epi32(swp64, min128);
+
+    auto swp32 = _mm_shuffle_epi32(min64, _MM_SHUFFLE2(0, 1));
+    auto min32 = _mm_min_epi32(swp32, min64);
+
+    type res = _mm_cvtsi128_si32(min32);
+    for (; k < size; ++k)
+      res = std::min(res, lptr[k] + rptr[k]);
+
+    return std::min(res, INF);
+  }
+};
+
+// Boolean semiring over 0/1 ints; see BitMatrix for the packed version
+struct OrAnd {
+  using type = std::int32_t;
+  static constexpr type ZERO = 0;
+  static constexpr type ONE = 1;
+
+  static type add(type lhs, type rhs) { return lhs | rhs; }
+  static type mul(type lhs, type rhs) { return lhs & rhs; }
+};
+} // namespace sr
+
+template <typename SR>
+concept HasDot = requires(const typename SR::type *ptr) {
+  { SR::dot(ptr, ptr, std::size_t{}) } -> std::same_as<typename SR::type>;
+};
+
+template <typename SR>
+typename SR::type semiringDot(const typename SR::type *lptr,
+                              const typename SR::type *rptr,
+                              std::size_t size) {
+  if constexpr (HasDot<SR>)
+    return SR::dot(lptr, rptr, size);
+  else {
+    auto res = SR::ZERO;
+    for (std::size_t k = 0; k < size; ++k)
+      res = SR::add(res, SR::mul(lptr[k], rptr[k]));
+    return res;
+  }
+}
+
+// Product over semiring SR: transposed rhs, rows split between threads
+template <typename SR>
+linal::Matrix<typename SR::type>
+mulSemiring(const linal::Matrix<typename SR::type> &lhs,
+            const linal::Matrix<typename SR::type> &rhs) {
+  using SMat = linal::Matrix<typename SR::type>;
+
+  if (lhs.getCols() != rhs.getRows())
+    throw std::invalid_argument{"Incompatible matrix sizes"};
+
+  SMat rhs_t{rhs.Transposing()};
+  SMat res{lhs.getRows(), rhs.getCols()};
+
+  std::size_t res_r = res.getRows(), res_c = res.getCols(),
+              com_sz = lhs.getCols();
+
+#pragma omp parallel for schedule(static)
+  for (std::size_t i = 0; i < res_r; ++i)
+    for (std::size_t j = 0; j < res_c; ++j)
+      res[i][j] = semiringDot<SR>(lhs[i], rhs_t[j], com_sz);
+
+  return res;
+}
+
+// All-pairs shortest paths by repeated min-plus squaring of the weight
+// matrix: after s squarings paths of up to 2^s edges are covered.
+// Missing edges must hold sr::MinPlus::INF.
+Mat shortestPaths(const Mat &weights) {
+  if (weights.getRows() != weights.getCols())
+    throw std::invalid_argument{"Weight matrix must be square"};
+
+  auto dist = weights;
+  std::size_t size = dist.getRows();
+  for (std::size_t i = 0; i < size; ++i)
+    dist[i][i] = std::min(dist[i][i], sr::MinPlus::ONE);
+
+  for (std::size_t len = 1; len < size; len *= 2)
+    dist = mulSemiring<sr::MinPlus>(dist, dist);
+
+  return dist;
+}
+
+} // namespace mul
+
+#endif // __SEM7_OPENMP_8_MATMUL_SEMIRING_HH__
@@ -4,21 +4,34 @@
 #include <functional>
 #include <iostream>
 #include <omp.h>
+#include <stdexcept>
+#include <string>
 #include <string_view>
 #include <vector>
 
-constexpr std::size_t ISIZE = 5000;
-constexpr std::size_t JSIZE = 5000;
+#include "array2d.hh"
+#include "bench.hh"
+#include "dump.hh"
+#include "loopnest.hh"
+#include "vsin.hh"
 
-using ArrTy = std::vector<std::vector<double>>;
+// Array size, "size=IxJ" on the command line
+std::size_t ISIZE = 5000;
+std::size_t JSIZE = 5000;
+
+using ArrTy = lab::Array2D<double>;
+
+// Row sine kernel, see vsin.hh; the same one is used by all versions so
+// that their results stay comparable
+lab::RowSin rowSin = lab::sinRowLibm;
 
 void printArr(const ArrTy &arr, std::ostream &ost)
 {
-  for (auto &&row : arr)
+  for (std::size_t i = 0; i < arr.getRows(); i++)
   {
-    for (auto elem : row)
-      ost << elem << " ";
-    ost << std::endl;
+    for (std::size_t j = 0; j < arr.getCols(); j++)
+      ost << arr[i][j] << " ";
+    ost << '\n';
   }
 }
 
@@ -28,8 +41,7 @@ void ethalon(ArrTy &arr)
 {
 #pragma omp parallel for
   for (std::size_t i = 0; i < ISIZE; i++)
-    for (std::size_t j = 0; j < JSIZE; j++)
-      arr[i][j] = std::sin(2 * arr[i][j]);
+    rowSin(arr[i], arr[i], JSIZE, 2);
 }
 
 void processArr(ArrTy &arr)
@@ -38,10 +50,11 @@ void processArr(ArrTy &arr)
   // for (std::size_t i = 0; i < ISIZE - 3; i++)
   //   for (std::size_t j = 4; j < JSIZE; j++)
   //     arr[i][j] = std::sin(0.2 * arr[i + 3][j - 4]);
-  // Normalized version
+  // Normalized version, the inner loop
+  //   arr[i][j + 4] = std::sin(0.2 * arr[i + 3][j]), j < JSIZE - 4
+  // is one row kernel call
   for (std::size_t i = 0; i < ISIZE - 3; i++)
-    for (std::size_t j = 0; j < JSIZE - 4; j++)
-      arr[i][j + 4] = std::sin(0.2 * arr[i + 3][j]);
+    rowSin(arr[i] + 4, arr[i + 3], JSIZE - 4, 0.2);
 }
 // Check bernstein condition:
 // F(k1, k2) = (k1, k2 + 3)
@@ -54,28 +67,64 @@ void processArr(ArrTy &arr)
 // > ==> i anti-dependency
 // < ==> j true-dependency
 
+// Parallel version: every thread takes a contiguous block of rows and goes
+// through it upwards, so inside the block row i + 3 is read before it is
+// overwritten. Only the 3 rows past the block belong to other threads;
+// their original values are saved before anybody starts writing.
+constexpr std::size_t IDIST = 3;
+
 void processArrPar(ArrTy &arr)
 {
-  auto oldArr = arr;
-#pragma omp parallel for schedule(static, 3)
-  for (std::size_t i = 0; i < ISIZE - 3; i++)
+#pragma omp parallel
   {
-    auto arrnxt = oldArr[i + 3];
-#pragma omp parallel for schedule(static, 4)
-    for (std::size_t j = 0; j < JSIZE - 4; j++)
-      arr[i][j + 4] = std::sin(0.2 * arrnxt[j]);
+    std::size_t nthr = omp_get_num_threads(), tid = omp_get_thread_num();
+    auto rows = ISIZE - IDIST;
+    auto ibeg = rows * tid / nthr, iend = rows * (tid + 1) / nthr;
+
+    ArrTy saved{IDIST, JSIZE, [&arr, iend](auto i, auto j) {
+                  return arr[iend + i][j];
+                }};
+#pragma omp barrier
+
+    for (auto i = ibeg; i < iend; i++)
+    {
+      auto src = i + IDIST < iend ? arr[i + IDIST] : saved[i + IDIST - iend];
+      rowSin(arr[i] + 4, src, JSIZE - 4, 0.2);
+    }
   }
 }
 
-void measureDump(ProcFunc f, ArrTy &arr, std::string_view filename)
+// Same nest run in place by the loop nest executor: the anti-dependence
+// D = (-3, 4) is kept, so it picks a skewed wavefront of tiles
+lab::LoopNest2D nest()
+{
+  return {0, ISIZE - 3, 0, JSIZE - 4, {{-3, 4}}};
+}
+
+void processArrNest(ArrTy &arr)
 {
-  auto time = omp_get_wtime();
-  f(arr);
-  auto elapsed_ms = (omp_get_wtime() - time) * 1000;
+  lab::run(nest(), [&arr](auto i, auto jb, auto je) {
+    rowSin(arr[i] + 4 + jb, arr[i + 3] + jb, je - jb, 0.2);
+  });
+}
 
-  std::cout << "Elapsed time " << elapsed_ms  << " ms" << std::endl;
+// Writes name.bin, or name.txt if text is set
+void dump(const ArrTy &arr, std::string_view name, bool text)
+{
+  if (!text)
+  {
+    try
+    {
+      lab::DumpFile<double>{std::string{name} + ".bin"}.write(arr);
+    }
+    catch (const std::runtime_error &err)
+    {
+      std::cerr << err.what() << std::endl;
+    }
+    return;
+  }
 
-  std::ofstream of(filename.data());
+  std::ofstream of(std::string{name} + ".txt");
   if (!of)
   {
     std::cerr << "Cannot open file for results" << std::endl;
@@ -86,30 +135,99 @@ void measureDump(ProcFunc f, ArrTy &arr, std::string_view filename)
 
 void initArr(ArrTy &a)
 {
-  a.resize(ISIZE);
   // Fill array with data
-  for (std::size_t i = 0; i < a.size(); i++)
-  {
-    auto &ai = a[i];
-    ai.resize(JSIZE);
-    for (std::size_t j = 0; j < ai.size(); j++)
-      ai[j] = 10 * i + j;
-  }
+  a = ArrTy{ISIZE, JSIZE, [](auto i, auto j) { return 10 * i + j; }};
 }
 
-int main()
+// Runs f on a fresh array and dumps the result, as many times as cfg says
+lab::BenchRecord measureDump(ProcFunc f, std::string_view name, bool text,
+                             const lab::BenchConfig &cfg)
 {
-  ArrTy a{};
-  initArr(a);
+  ArrTy arr{};
+  lab::BenchCase bc{[&arr] { initArr(arr); },
+                    [&](lab::PhaseTimer &) { f(arr); },
+                    [&] { dump(arr, name, text); }};
 
-  std::cout << "Sequential:" << std::endl;
-  measureDump(processArr, a, "seq.txt");
+  lab::BenchRecord rec{};
+  rec.name = name;
+  rec.threads = omp_get_max_threads();
+  rec.rows = ISIZE, rec.cols = JSIZE, rec.repeats = cfg.repeats;
+  rec.stats = lab::runBench(bc, cfg);
+  return rec;
+}
 
-  initArr(a);
-  std::cout << "Parallel:" << std::endl;
-  measureDump(processArrPar, a, "par.txt");
+int main(int argc, char *argv[])
+{
+  // "text": write text dumps instead of binary ones
+  // "sin=libm|ulp1|fast": row sine kernel
+  // "size=IxJ", "bench=N", "warmup=N", "report=csv|json": see bench.hh
+  bool text = false;
+  lab::BenchArgs args{};
+  try
+  {
+    for (int i = 1; i < argc; i++)
+    {
+      std::string_view arg{argv[i]};
+      text = text || arg == "text";
+      if (arg.starts_with("sin="))
+        rowSin = lab::rowSinByName(arg.substr(4));
+      lab::parseBenchArg(arg, args);
+    }
+  }
+  catch (const std::invalid_argument &err)
+  {
+    std::cerr << err.what() << std::endl;
+    return 1;
+  }
+
+  if (rowSin == nullptr)
+  {
+    std::cerr << "Unknown sine kernel" << std::endl;
+    return 1;
+  }
+
+  if (args.rows != 0)
+    ISIZE = args.rows, JSIZE = args.cols;
+  if (ISIZE <= IDIST || JSIZE <= 4)
+  {
+    std::cerr << "Array must be larger than 3x4" << std::endl;
+    return 1;
+  }
+
+  // Without "bench" every version runs once and prints its time
+  auto cfg = args.bench ? args.cfg : lab::BenchConfig{0, 1};
+
+  struct Case
+  {
+    std::string_view name;
+    std::string title;
+    ProcFunc func;
+  };
+  std::vector<Case> cases{
+      {"seq", "Sequential:", processArr},
+      {"par", "Parallel:", processArrPar},
+      {"nest",
+       "Loop nest (" +
+           std::string{lab::scheduleName(lab::plan(nest()).sched)} + "):",
+       processArrNest},
+      {"eth", "Ethalon:", ethalon}};
+
+  std::vector<lab::BenchRecord> records{};
+  for (auto &&[name, title, func] : cases)
+  {
+    if (!args.bench)
+      std::cout << title << std::endl;
+
+    records.push_back(measureDump(func, name, text, cfg));
+    if (!args.bench)
+    {
+      auto &&compute = records.back().stats[static_cast<std::size_t>(
+          lab::Phase::Compute)];
+      std::cout << "Elapsed time " << compute.median * 1000 << " ms"
+                << std::endl;
+    }
+  }
 
-  initArr(a);
-  std::cout << "Ethalon:" << std::endl;
-  measureDump(ethalon, a, "eth.txt");
+  if (args.bench)
+    lab::writeReport(std::cout, records, args.fmt);
 }
@@ -0,0 +1,216 @@
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+#include <fcntl.h>
+#include <omp.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "dump.hh"
+
+// Compares two binary dumps (see include/dump.hh) element by element.
+// Elements match if they differ by at most ATOL or by at most MAX_ULP
+// units in the last place; both default to 0, i.e. exact comparison.
+// Exit status: 0 - dumps match, 1 - mismatches found, 2 - error.
+
+// Read-only mapping of a whole file
+class Mapping final {
+  void *ptr_ = MAP_FAILED;
+  std::size_t size_ = 0;
+
+public:
+  explicit Mapping(const std::string &name) {
+    int fd = open(name.c_str(), O_RDONLY);
+    if (fd < 0)
+      throw std::runtime_error{"Cannot open " + name};
+
+    struct stat st {};
+    if (fstat(fd, &st) == 0 && st.st_size > 0) {
+      size_ = st.st_size;
+      ptr_ = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+    }
+    close(fd);
+
+    if (ptr_ == MAP_FAILED)
+      throw std::runtime_error{"Cannot map " + name};
+    madvise(ptr_, size_, MADV_SEQUENTIAL);
+  }
+
+  Mapping(const Mapping &) = delete;
+  Mapping &operator=(const Mapping &) = delete;
+  ~Mapping() { munmap(ptr_, size_); }
+
+  const char *data() const { return static_cast<const char *>(ptr_); }
+  std::size_t size() const { return size_; }
+};
+
+struct Dump {
+  Mapping map;
+  const lab::DumpHeader *hdr = nullptr;
+
+  explicit Dump(const std::string &name) : map(name) {
+    hdr = reinterpret_cast<const lab::DumpHeader *>(map.data());
+    if (map.size() < sizeof(lab::DumpHeader) || !hdr->valid())
+      throw std::runtime_error{name + " is not a dump"};
+    if (map.size() < sizeof(lab::DumpHeader) + hdr->count * hdr->arrayBytes())
+      throw std::runtime_error{name + " is truncated"};
+  }
+
+  // Element (i, j) of array k, whatever the layout is
+  template <typename T>
+  T get(std::size_t k, std::size_t i, std::size_t j) const {
+    auto base = reinterpret_cast<const T *>(map.data() + sizeof(*hdr));
+    auto idx = hdr->layout == lab::Layout::RowMajor ? i * hdr->cols + j
+                                                    : j * hdr->rows + i;
+    return base[k * hdr->rows * hdr->cols + idx];
+  }
+};
+
+constexpr auto NONE = std::numeric_limits<std::uint64_t>::max();
+
+struct Stats {
+  std::uint64_t mismatches = 0, first = NONE, max_abs_idx = NONE,
+                max_ulp_idx = NONE;
+  long double max_abs = 0, max_ulp = 0;
+
+  void merge(const Stats &other) {
+    mismatches += other.mismatches;
+    first = std::min(first, other.first);
+    if (other.max_abs > max_abs)
+      max_abs = other.max_abs, max_abs_idx = other.max_abs_idx;
+    if (other.max_ulp > max_ulp)
+      max_ulp = other.max_ulp, max_ulp_idx = other.max_ulp_idx;
+  }
+};
+
+// Distance in units of the last place of the larger operand
+template <typename T> long double ulpDiff(T lhs, T rhs) {
+  if (lhs == rhs)
+    return 0;
+  if (std::isnan(lhs) || std::isnan(rhs))
+    return std::numeric_limits<long double>::infinity();
+
+  auto big = std::max(std::abs(lhs), std::abs(rhs));
+  auto ulp = std::nextafter(big, std::numeric_limits<T>::infinity()) - big;
+  return static_cast<long double>(std::abs(lhs - rhs)) / ulp;
+}
+
+template <typename T>
+Stats compare(const Dump &lhs, const Dump &rhs, long double atol,
+              long double max_ulp) {
+  std::uint64_t rows = lhs.hdr->rows, cols = lhs.hdr->cols,
+                all_rows = lhs.hdr->count * rows;
+  Stats res{};
+
+#pragma omp parallel
+  {
+    Stats loc{};
+
+#pragma omp for schedule(static)
+    for (std::uint64_t row = 0; row < all_rows; ++row)
+      for (std::uint64_t j = 0; j < cols; ++j) {
+        auto k = row / rows, i = row % rows, idx = row * cols + j;
+        auto lval = lhs.get<T>(k, i, j), rval = rhs.get<T>(k, i, j);
+        if (lval == rval)
+          continue;
+
+        auto abs_diff = std::isnan(lval) || std::isnan(rval)
+                            ? std::numeric_limits<long double>::infinity()
+                            : std::abs(static_cast<long double>(lval) - rval);
+        auto ulp_diff = ulpDiff(lval, rval);
+
+        if (abs_diff > loc.max_abs || loc.max_abs_idx == NONE)
+          loc.max_abs = abs_diff, loc.max_abs_idx = idx;
+        if (ulp_diff > loc.max_ulp || loc.max_ulp_idx == NONE)
+          loc.max_ulp = ulp_diff, loc.max_ulp_idx = idx;
+
+        if (abs_diff > atol && ulp_diff > max_ulp) {
+          ++loc.mismatches;
+          loc.first = std::min(loc.first, idx);
+        }
+      }
+
+#pragma omp critical
+    res.merge(loc);
+  }
+
+  return res;
+}
+
+// Prints position and values of element idx, and diff if it is given
+template <typename T>
+void report(std::string_view what, std::uint64_t idx, const Dump &lhs,
+            const Dump &rhs, long double diff = -1) {
+  if (idx == NONE)
+    return;
+
+  std::uint64_t rows = lhs.hdr->rows, cols = lhs.hdr->cols;
+  auto k = idx / (rows * cols), i = idx / cols % rows, j = idx % cols;
+  std::cout.precision(std::numeric_limits<T>::max_digits10);
+  std::cout << what << ": array " << k << " (" << i << ", " << j
+            << "): " << lhs.get<T>(k, i, j) << " vs " << rhs.get<T>(k, i, j);
+  if (diff >= 0)
+    std::cout << ", diff " << diff;
+  std::cout << std::endl;
+}
+
+template <typename T>
+int run(const Dump &lhs, const Dump &rhs, long double atol,
+        long double max_ulp) {
+  auto tic = omp_get_wtime();
+  auto stats = compare<T>(lhs, rhs, atol, max_ulp);
+  auto toc = omp_get_wtime();
+
+  auto total = lhs.hdr->count * lhs.hdr->rows * lhs.hdr->cols;
+  std::cout << "Compared " << total << " elements in "
+            << (toc - tic) * 1000 << " ms, mismatches: " << stats.mismatches
+            << std::endl;
+  report<T>("First mismatch", stats.first, lhs, rhs);
+  report<T>("Largest abs diff", stats.max_abs_idx, lhs, rhs, stats.max_abs);
+  report<T>("Largest ulp diff", stats.max_ulp_idx, lhs, rhs, stats.max_ulp);
+
+  return stats.mismatches == 0 ? 0 : 1;
+}
+
+int main(int ac, char **av) {
+  if (ac < 3) {
+    std::cout << "Usage: " << av[0] << " LHS RHS [ATOL] [MAX_ULP]"
+              << std::endl;
+    return 2;
+  }
+
+  long double atol = ac > 3 ? std::strtold(av[3], nullptr) : 0;
+  long double max_ulp = ac > 4 ? std::strtold(av[4], nullptr) : 0;
+
+  try {
+    Dump lhs{av[1]}, rhs{av[2]};
+    auto &&lh = *lhs.hdr, &&rh = *rhs.hdr;
+    if (lh.dtype != rh.dtype || lh.count != rh.count || lh.rows != rh.rows ||
+        lh.cols != rh.cols) {
+      std::cerr << "Dumps differ in shape or element type" << std::endl;
+      return 2;
+    }
+
+    switch (lh.dtype) {
+    case lab::DType::F32:
+      return run<float>(lhs, rhs, atol, max_ulp);
+    case lab::DType::F64:
+      return run<double>(lhs, rhs, atol, max_ulp);
+    case lab::DType::F80:
+      return run<long double>(lhs, rhs, atol, max_ulp);
+    }
+    throw std::runtime_error{"Unknown element type"};
+  } catch (const std::exception &err) {
+    std::cerr << err.what() << std::endl;
+    return 2;
+  }
+}
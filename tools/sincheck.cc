@@ -0,0 +1,69 @@
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <string_view>
+#include <vector>
+
+#include "vsin.hh"
+
+// Accuracy of the row sine kernels against std::sin on uniform samples of
+// several argument ranges, and their throughput. Exit status is nonzero
+// if a kernel exceeds its documented error bound.
+
+struct Kernel {
+  std::string_view name;
+  lab::RowSin func;
+  // bounds checked: ULP of the reference value and absolute error
+  double max_ulp, max_abs;
+};
+
+const auto KERNELS = std::to_array<Kernel>({
+    {"libm", lab::sinRowLibm, 0, 0},
+    {"ulp1", lab::sinRowUlp1, 1, 2.3e-16},
+    {"fast", lab::sinRowFast, 1e9, 1e-13},
+});
+
+constexpr auto RANGES = std::to_array<double>({1, 1e2, 1e4, 1e6, 1e9});
+
+int main(int ac, char **av) {
+  std::size_t size = ac > 1 ? std::atoll(av[1]) : 1 << 22;
+  std::mt19937_64 gen{1};
+  std::vector<double> src(size), ref(size), res(size);
+  bool ok = true;
+
+  std::cout << "# kernel, range, max ulp, max abs, Melem/s" << std::endl;
+  for (auto range : RANGES) {
+    std::uniform_real_distribution<double> dist{-range, range};
+    std::generate(src.begin(), src.end(), [&] { return dist(gen); });
+    lab::sinRowLibm(ref.data(), src.data(), size, 1);
+
+    for (auto &&kern : KERNELS) {
+      auto tic = std::chrono::steady_clock::now();
+      kern.func(res.data(), src.data(), size, 1);
+      std::chrono::duration<double> sec =
+          std::chrono::steady_clock::now() - tic;
+
+      double max_ulp = 0, max_abs = 0;
+      for (std::size_t i = 0; i < size; ++i) {
+        auto err = std::abs(res[i] - ref[i]), mag = std::abs(ref[i]);
+        auto ulp = std::nextafter(mag, INFINITY) - mag;
+        max_ulp = std::max(max_ulp, err / ulp);
+        max_abs = std::max(max_abs, err);
+      }
+
+      ok = ok && max_ulp <= kern.max_ulp && max_abs <= kern.max_abs;
+      std::cout << kern.name << ", " << range << ", " << max_ulp << ", "
+                << max_abs << ", " << size / sec.count() / 1e6 << std::endl;
+    }
+  }
+
+  std::cout << (ok ? "All kernels within bounds" : "Bounds EXCEEDED")
+            << std::endl;
+  return ok ? 0 : 1;
+}